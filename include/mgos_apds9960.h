@@ -34,11 +34,38 @@ enum mgos_apds9960_direction_t {
   APDS9960_DIR_ALL
 };
 
+/* A recognized gesture, see mgos_apds9960_get_last_gesture() */
+struct mgos_apds9960_gesture {
+  enum mgos_apds9960_direction_t direction;
+  uint8_t                        confidence;  // 0..100
+  uint16_t                       speed;       // Signal ratio swing, in percent per second
+  uint32_t                       duration_ms; // From gesture entry to exit
+};
+
+/*
+ * A gesture recognition engine. `feed` is called for every gesture FIFO
+ * dataset, in order and with its (estimated) acquisition time, and returns
+ * true once it recognized a gesture and filled in *result. `finish` is called
+ * when no more data is coming for the current gesture, and may still return a
+ * result from what was fed so far. `reset` discards all state. All callbacks
+ * are passed the `ctx` given to `mgos_apds9960_set_gesture_engine()`.
+ */
+struct mgos_apds9960_gesture_engine {
+  void (*reset)(void *ctx);
+  bool (*feed)(void *ctx, const struct mgos_apds9960_gesture_dataset *dataset, int64_t time_us, struct mgos_apds9960_gesture *result);
+  bool (*finish)(void *ctx, int64_t time_us, struct mgos_apds9960_gesture *result);
+};
 
 // Callback handlers
 typedef void (*mgos_apds9960_light_event_t)(uint16_t clear, uint16_t red, uint16_t green, uint16_t blue);
 typedef void (*mgos_apds9960_proximity_event_t)(uint8_t proximity);
 typedef void (*mgos_apds9960_gesture_event_t)(enum mgos_apds9960_direction_t direction);
+typedef void (*mgos_apds9960_gesture_stream_event_t)(struct mgos_apds9960 *sensor);
+typedef void (*mgos_apds9960_presence_event_t)(enum mgos_apds9960_direction_t state, uint8_t proximity);
+typedef void (*mgos_apds9960_saturation_event_t)(uint8_t status);
+
+// Routes the bus to `sensor`, eg. by switching an I2C multiplexer channel
+typedef bool (*mgos_apds9960_bus_select_t)(struct mgos_apds9960 *sensor, void *arg);
 
 /*
  * Initialize a APDS9960 on the I2C bus `i2c` at address specified in `i2caddr`
@@ -48,6 +75,147 @@ typedef void (*mgos_apds9960_gesture_event_t)(enum mgos_apds9960_direction_t dir
  */
 struct mgos_apds9960 *mgos_apds9960_create(struct mgos_i2c *i2c, uint8_t i2caddr);
 
+/*
+ * As `mgos_apds9960_create()`, but with the interrupt line of this particular
+ * sensor connected to GPIO `irq_pin` instead of the one set in `mos.yml`. Pass
+ * -1 for a sensor without an interrupt line.
+ */
+struct mgos_apds9960 *mgos_apds9960_create_irq(struct mgos_i2c *i2c, uint8_t i2caddr, int irq_pin);
+
+/*
+ * As `mgos_apds9960_create_irq()`, for a sensor behind an I2C multiplexer.
+ * `bus_select` is called with `arg` before talking to the sensor whenever a
+ * different sensor was addressed last, including during creation. If the
+ * application itself switches the multiplexer, it must call
+ * `mgos_apds9960_bus_release()` afterwards.
+ */
+struct mgos_apds9960 *mgos_apds9960_create_mux(struct mgos_i2c *i2c, uint8_t i2caddr, int irq_pin, mgos_apds9960_bus_select_t bus_select, void *arg);
+
+/*
+ * Forget which sensor the bus was last routed to, so that the next transfer
+ * calls its `bus_select` callback again.
+ */
+void mgos_apds9960_bus_release(void);
+
+/*
+ * Shared interrupt line: the APDS9960 interrupt output is open-drain, so
+ * several sensors may be wired to a single GPIO. A group owns that GPIO and
+ * services all of its sensors on every falling edge, one STATUS burst read
+ * each, in round-robin order, until the line is released. Sensors joining a
+ * group must have been created without an interrupt pin of their own (see
+ * `mgos_apds9960_create_irq()` with `irq_pin` -1). Their callbacks are then
+ * installed as usual with `mgos_apds9960_set_callback_*()`.
+ */
+struct mgos_apds9960_irq_group;
+
+struct mgos_apds9960_irq_group *mgos_apds9960_irq_group_create(int irq_pin);
+void mgos_apds9960_irq_group_destroy(struct mgos_apds9960_irq_group **group);
+bool mgos_apds9960_irq_group_add(struct mgos_apds9960_irq_group *group, struct mgos_apds9960 *sensor);
+bool mgos_apds9960_irq_group_remove(struct mgos_apds9960_irq_group *group, struct mgos_apds9960 *sensor);
+
+/* A timestamped reading, see `mgos_apds9960_sampler_create()` */
+struct mgos_apds9960_sample {
+  struct mgos_apds9960 *    sensor;
+  int64_t                   time_us;   // When the sample was read from the sensor
+  uint8_t                   status;    // STATUS register as read with the data
+  struct mgos_apds9960_rgbc rgbc;      // Fresh if status has APDS9960_STATUS_AVALID
+  uint8_t                   proximity; // Fresh if status has APDS9960_STATUS_PVALID
+};
+
+typedef void (*mgos_apds9960_sample_event_t)(const struct mgos_apds9960_sample *sample, void *arg);
+
+/*
+ * Wait for the next light and/or proximity conversion to complete, as
+ * signalled by the AVALID/PVALID bits in STATUS (pass the `APDS9960_STATUS_*`
+ * bits required in `valid`), and read it into *sample. Data already read
+ * before is never returned twice. The wait is bounded by one sensor cycle as
+ * computed from ATIME/WTIME/WLONG, plus a small margin. Blocks the calling
+ * task; returns true on success, or false on timeout, bus error, or if the
+ * requested engines are not enabled.
+ */
+bool mgos_apds9960_wait_for_sample(struct mgos_apds9960 *sensor, uint8_t valid, struct mgos_apds9960_sample *sample);
+
+/*
+ * As `mgos_apds9960_wait_for_sample()`, but returns immediately and calls
+ * `handler` with `arg` once the sample is read, or with a NULL sample on
+ * timeout. One request can be pending per sensor.
+ * Returns true if the request was started, or false otherwise.
+ */
+bool mgos_apds9960_read_sample_async(struct mgos_apds9960 *sensor, uint8_t valid, mgos_apds9960_sample_event_t handler, void *arg);
+
+/*
+ * Periodic sampling of light and proximity data across several sensors. Every
+ * `period_ms`, rounded up to a whole number of sensor cycles (see
+ * `mgos_apds9960_get_cycle_time()`), all sensors of the sampler are read back
+ * to back with one burst each, and `handler` is called with `arg` for every
+ * sensor that completed a conversion since the previous read. Sensors whose
+ * ATIME/WTIME/ENABLE change after being added should be followed by a call to
+ * `mgos_apds9960_sampler_resync()`. A sensor belongs to one sampler at a time.
+ * Note that light and proximity interrupt handlers also consume the data, so
+ * samples coinciding with an interrupt are delivered there instead.
+ */
+struct mgos_apds9960_sampler;
+
+struct mgos_apds9960_sampler *mgos_apds9960_sampler_create(uint32_t period_ms, mgos_apds9960_sample_event_t handler, void *arg);
+void mgos_apds9960_sampler_destroy(struct mgos_apds9960_sampler **sampler);
+bool mgos_apds9960_sampler_add(struct mgos_apds9960_sampler *sampler, struct mgos_apds9960 *sensor);
+bool mgos_apds9960_sampler_remove(struct mgos_apds9960_sampler *sampler, struct mgos_apds9960 *sensor);
+bool mgos_apds9960_sampler_resync(struct mgos_apds9960_sampler *sampler);
+uint32_t mgos_apds9960_sampler_get_interval(struct mgos_apds9960_sampler *sampler);
+
+/* Power profiles, see mgos_apds9960_set_power_profile() */
+enum mgos_apds9960_power_profile {
+  APDS9960_POWER_PRESENCE,  // Proximity only, ~3.7Hz, 4 pulses at 25mA
+  APDS9960_POWER_BALANCED,  // Proximity and light, ~7.5Hz at the default ATIME
+  APDS9960_POWER_GESTURE,   // Proximity every 4ms and back to back gesture datasets
+};
+
+/* Estimated supply current and sample rate, LED current included */
+struct mgos_apds9960_power_estimate {
+  uint32_t cycle_us;             // One pass through the proximity, wait and ALS states
+  uint32_t sample_rate_millihz;  // Proximity/light samples per 1000 seconds
+  uint32_t current_ua;           // Average, without gesture activity
+  uint32_t gesture_rate_hz;      // Gesture datasets per second while a gesture is in progress
+  uint32_t gesture_current_ua;   // Average while a gesture is in progress
+};
+
+/*
+ * Apply a named power profile: the enabled engines (ALS, proximity, wait,
+ * gesture), WTIME/WLONG, proximity and gesture pulses, LED drive and boost are
+ * set together, trading latency for current. Interrupt enables, gains and
+ * ATIME are left as they are; gesture handlers are installed separately. If
+ * `est` is not NULL, the resulting estimate is returned in it.
+ * `mgos_apds9960_get_power_estimate()` computes the same estimate for the
+ * configuration currently in effect, from the datasheet supply currents
+ * (200uA ALS, 790uA proximity/gesture, 38uA wait, 1uA sleep) plus the LED
+ * pulse duty cycle.
+ * Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_set_power_profile(struct mgos_apds9960 *sensor, enum mgos_apds9960_power_profile profile, struct mgos_apds9960_power_estimate *est);
+bool mgos_apds9960_get_power_estimate(struct mgos_apds9960 *sensor, struct mgos_apds9960_power_estimate *est);
+
+/* Completion of an asynchronous register operation, `data` holds `len` bytes
+ * from `reg` onwards: as read, or as written */
+typedef void (*mgos_apds9960_async_done_t)(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *data, uint8_t len, bool ok, void *arg);
+
+/*
+ * Asynchronous register access: reads and writes of up to 32 bytes are queued
+ * (16 operations across all sensors) and carried out from the Mongoose OS
+ * event loop, a few transfers at a time, so that other tasks and bus users
+ * can run in between. Operations directly following each other in the queue
+ * which continue the same register range of the same sensor, in the same
+ * direction, are merged into one auto-increment block transfer. `done`, which
+ * may be NULL, is called with `arg` after the transfer, in submission order.
+ * `mgos_apds9960_async_flush()` carries out all pending operations right away.
+ * Operations still pending when their sensor is destroyed are dropped.
+ * A range may not run past register 0xFF, except for a read from the gesture
+ * FIFO (0xFC, GFIFO_U), which pops one U/D/L/R dataset per 4 bytes.
+ * Returns true if the operation was queued, or false otherwise.
+ */
+bool mgos_apds9960_async_read(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t len, mgos_apds9960_async_done_t done, void *arg);
+bool mgos_apds9960_async_write(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *data, uint8_t len, mgos_apds9960_async_done_t done, void *arg);
+void mgos_apds9960_async_flush(void);
+
 /*
  * Destroy the data structure associated with a APDS9960 device. The reference
  * to the pointer of the `struct mgos_apds9960` has to be provided, and upon
@@ -57,7 +225,8 @@ struct mgos_apds9960 *mgos_apds9960_create(struct mgos_i2c *i2c, uint8_t i2caddr
 void mgos_apds9960_destroy(struct mgos_apds9960 **sensor);
 
 /*
- * Install an interrupt (see `mos.yml` key `apds9960.irq_pin`), and when the
+ * Install an interrupt (see `mos.yml` key `apds9960.irq_pin`, or the
+ * `irq_pin` passed to `mgos_apds9960_create_irq()`), and when the
  * interrupt is asserted, call a callback for `light`, `proximity` and/or
  * `gesture` events.
  *
@@ -74,15 +243,189 @@ bool mgos_apds9960_set_callback_light(struct mgos_apds9960 *sensor, uint16_t low
 bool mgos_apds9960_set_callback_proximity(struct mgos_apds9960 *sensor, uint8_t low_threshold, uint8_t high_threshold, mgos_apds9960_proximity_event_t handler);
 bool mgos_apds9960_set_callback_gesture(struct mgos_apds9960 *sensor, mgos_apds9960_gesture_event_t handler);
 
+/*
+ * Install a light interrupt which reports changes rather than levels: after
+ * every interrupt, the handler is called and the AILT/AIHT window is
+ * re-centered around the new clear channel reading. Its half width is the
+ * larger of `delta` counts and `delta_pct` percent of the reading, so the
+ * interrupt rate follows how much the light actually changes. The window
+ * starts out empty, which reports the current level after the first
+ * conversion. This replaces the fixed window of `mgos_apds9960_set_callback_light()`,
+ * and vice versa.
+ * Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_set_callback_light_change(struct mgos_apds9960 *sensor, uint16_t delta, uint8_t delta_pct, mgos_apds9960_light_event_t handler);
+
+/*
+ * Install an interrupt on saturation: `sources` is `APDS9960_STATUS_CPSAT`
+ * (the clear channel reached full scale) and/or `APDS9960_STATUS_PGSAT` (the
+ * proximity/gesture front end saturated, eg. in direct sunlight). The handler,
+ * which may be NULL, is called with the STATUS register. With `auto_adjust`,
+ * the driver also responds by itself: on CPSAT, the ALS moves to the next
+ * less sensitive gain and integration time (see
+ * `mgos_apds9960_read_light_normalized()`), on PGSAT the proximity gain and
+ * then the LED drive are reduced by one step. Once nothing is left to reduce,
+ * that saturation interrupt is disabled again. While enabled, light and
+ * proximity handlers are not called with saturated readings.
+ * Pass 0 as `sources` to disable saturation interrupts.
+ * Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_set_callback_saturation(struct mgos_apds9960 *sensor, uint8_t sources, bool auto_adjust, mgos_apds9960_saturation_event_t handler);
+
+/*
+ * Install an interrupt driven proximity presence detector. The handler is
+ * called with `APDS9960_DIR_NEAR` once the proximity value stayed above
+ * `near_threshold` for `persistence` consecutive proximity cycles (1..15),
+ * and with `APDS9960_DIR_FAR` once it stayed below `far_threshold` as long.
+ * The interrupt window is flipped on every transition: while far, only
+ * approaching can interrupt, and while near, only release, so each presence
+ * event costs two interrupts. `far_threshold` must be below `near_threshold`.
+ * This replaces a handler installed with `mgos_apds9960_set_callback_proximity()`,
+ * and vice versa. The sensor starts out as far; a target already in range
+ * is reported as NEAR after `persistence` cycles.
+ * Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_set_callback_presence(struct mgos_apds9960 *sensor, uint8_t far_threshold, uint8_t near_threshold, uint8_t persistence,
+                                         mgos_apds9960_presence_event_t handler);
+
+/*
+ * Return `APDS9960_DIR_NEAR` or `APDS9960_DIR_FAR` as last reported to the
+ * presence handler, or `APDS9960_DIR_NONE` if none is installed.
+ */
+enum mgos_apds9960_direction_t mgos_apds9960_get_presence(struct mgos_apds9960 *sensor);
+
+/*
+ * Install a callback which is called every time new raw gesture datasets were
+ * drained from the sensor's gesture FIFO. The handler reads them in place with
+ * `mgos_apds9960_gesture_peek()` and `mgos_apds9960_gesture_consume()`, using a
+ * cursor set up by `mgos_apds9960_gesture_cursor_init()`. This can be used to
+ * run an application specific recognizer alongside (or instead of) the
+ * `gesture` handler.
+ *
+ * Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_set_callback_gesture_stream(struct mgos_apds9960 *sensor, mgos_apds9960_gesture_stream_event_t handler);
+
+/*
+ * Return the STATUS register (see `APDS9960_STATUS_*` in `mgos_apds9960_api.h`)
+ * as it was read when the most recent interrupt was serviced. This is meant to
+ * be called from within `light`, `proximity` and `gesture` handlers to inspect
+ * the PVALID/AVALID and saturation (PGSAT/CPSAT) bits without another bus
+ * transaction.
+ */
+uint8_t mgos_apds9960_get_irq_status(struct mgos_apds9960 *sensor);
+
 /*
  * Read the clear (ambient), red, green, and blue light values from the sensor.
- * Lower values mean less light was detected. The arguments clear, red, green
- * and blue may be NULL, in which case they are not polled from the sensor.
+ * Lower values mean less light was detected. All four channels are read in a
+ * single I2C burst, so they always stem from the same integration cycle. The
+ * arguments clear, red, green and blue may be NULL, in which case they are not
+ * returned.
  * Returns true on success, or false otherwise. If false is returned, the
  * values of clear, red, green and blue cannot be used.
  */
 bool mgos_apds9960_read_light(struct mgos_apds9960 *sensor, uint16_t *clear, uint16_t *red, uint16_t *green, uint16_t *blue);
 
+/* Light reading scaled to 64x gain and the longest integration time */
+struct mgos_apds9960_light {
+  bool     valid;  // False while a conversion is discarded, see below
+  uint32_t clear;
+  uint32_t red;
+  uint32_t green;
+  uint32_t blue;
+  uint8_t  gain;   // APDS9960_AGAIN_* the raw counts were taken with
+  uint8_t  atime;  // ATIME the raw counts were taken with
+};
+
+/*
+ * Read the clear, red, green and blue light values, normalised to a common
+ * scale independent of the ALS gain and integration time in effect: counts
+ * are scaled to 64x gain and 256 integration steps (712ms). With auto-ranging
+ * enabled, each new conversion is also used to adjust gain and integration
+ * time: the sensor moves to a less sensitive range on saturation (CPSAT or a
+ * clear count near full scale), and to a more sensitive one when the clear
+ * count would stay well below full scale there. In bright light this selects
+ * short integration times, for faster sampling and lower power. Light
+ * interrupt thresholds are in raw counts and are not adjusted.
+ * The first conversion after a range change is discarded: the call then
+ * succeeds with `valid` false, and the values are to be read again on the
+ * next cycle.
+ * Returns true on success, or false on error.
+ */
+bool mgos_apds9960_set_light_autorange(struct mgos_apds9960 *sensor, bool enable);
+bool mgos_apds9960_read_light_normalized(struct mgos_apds9960 *sensor, struct mgos_apds9960_light *light);
+
+/*
+ * Coefficients for lux and colour temperature, in the form of AMS design note
+ * DN40. Channel and glass attenuation coefficients are in 1/1000: `ga` is
+ * 1000 for a sensor in open air, and larger behind glass which passes less
+ * light. Defaults are the DN40 open air values.
+ */
+struct mgos_apds9960_lux_coef {
+  int16_t  r_coef;     // 1/1000
+  int16_t  g_coef;     // 1/1000
+  int16_t  b_coef;     // 1/1000
+  uint16_t ct_coef;    // Kelvin
+  uint16_t ct_offset;  // Kelvin
+  uint16_t df;         // Device factor
+  uint16_t ga;         // Glass attenuation, 1/1000
+};
+
+/*
+ * Set the lux/CCT coefficients of the sensor, or restore the defaults if
+ * `coef` is NULL. Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_set_lux_coefficients(struct mgos_apds9960 *sensor, const struct mgos_apds9960_lux_coef *coef);
+
+/*
+ * Compute illuminance (in millilux) and correlated colour temperature (in
+ * Kelvin) using integer arithmetic only. `mgos_apds9960_read_lux()` reads a
+ * fresh RGBC sample and takes the ALS gain and integration time currently in
+ * effect into account; `mgos_apds9960_light_to_lux()` converts a valid reading from
+ * `mgos_apds9960_read_light_normalized()`. Either of `mlux` and `cct` may be
+ * NULL. A CCT of 0 means it could not be determined (eg. in darkness), and
+ * it is capped at 65535 for strongly blue light. `mgos_apds9960_read_lux()`
+ * fails while the clear channel is saturated.
+ * Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_read_lux(struct mgos_apds9960 *sensor, uint32_t *mlux, uint16_t *cct);
+bool mgos_apds9960_light_to_lux(struct mgos_apds9960 *sensor, const struct mgos_apds9960_light *light, uint32_t *mlux, uint16_t *cct);
+
+/* Offset register values, in the sensor's sign/magnitude format */
+struct mgos_apds9960_calibration {
+  uint8_t poffset_ur;
+  uint8_t poffset_dl;
+  uint8_t goffset_u;
+  uint8_t goffset_d;
+  uint8_t goffset_l;
+  uint8_t goffset_r;
+};
+
+/*
+ * Null the proximity and gesture crosstalk (eg. reflections from a cover
+ * glass). Must be run with no target in front of the sensor. For each of the
+ * two proximity photodiode pairs (masking the other one) and each of the four
+ * gesture channels (with the gesture engine forced on), the smallest offset
+ * bringing the baseline down to a few counts is found by binary search. The
+ * offsets are applied and returned in *cal; the previous configuration is
+ * restored afterwards. Blocks for roughly a second.
+ * Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_calibrate(struct mgos_apds9960 *sensor, struct mgos_apds9960_calibration *cal);
+bool mgos_apds9960_set_calibration(struct mgos_apds9960 *sensor, const struct mgos_apds9960_calibration *cal);
+bool mgos_apds9960_get_calibration(struct mgos_apds9960 *sensor, struct mgos_apds9960_calibration *cal);
+
+/*
+ * Store calibration results in the `apds9960.calib` section of the device
+ * config, or load them from there. Load returns false if none was stored.
+ * The config holds a single set, which sensor creation applies automatically
+ * to the sensor at the `apds9960.i2caddr` address, unless it is behind a
+ * multiplexer (`mgos_apds9960_create_mux()` with a `bus_select` callback).
+ * Other sensors keep their offsets with `mgos_apds9960_set_calibration()`.
+ */
+bool mgos_apds9960_save_calibration(const struct mgos_apds9960_calibration *cal);
+bool mgos_apds9960_load_calibration(struct mgos_apds9960_calibration *cal);
+
 /*
  * Read the proximity value from the sensor. Lower values mean further away,
  * higher values mean closer to the sensor.
@@ -97,9 +440,38 @@ bool mgos_apds9960_read_proximity(struct mgos_apds9960 *sensor, uint8_t *proximi
 bool mgos_apds9960_is_gesture_available(struct mgos_apds9960 *sensor);
 
 /*
- * Compute the direction in which a gesture was sensed in the enum pointed to by
- * *direction. Returns true if the gesture sensor could be read. Note: the return
- * value does not correlate with a successful gesture computation! `APDS9960_DIR_NONE`
- * is written to *direction and true returned if no gesture could be determined.
+ * Replace the gesture recognition engine of the sensor. Passing NULL for
+ * `engine` restores the built-in engine, which compares the up/down and
+ * left/right signal ratios at gesture entry and exit, normalised by the total
+ * signal, in integer arithmetic. Besides UP/DOWN/LEFT/RIGHT, it reports NEAR
+ * and FAR for a target approaching or receding without lateral motion, and ALL
+ * for motion along both axes without a dominant direction.
+ * Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_set_gesture_engine(struct mgos_apds9960 *sensor, const struct mgos_apds9960_gesture_engine *engine, void *ctx);
+
+/*
+ * Tune the built-in gesture engine: datasets count towards a gesture when all
+ * four channels exceed `threshold`, and the entry-to-exit ratio swing (in
+ * percent, at most 200) must reach `sensitivity` for a direction to be
+ * reported. Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_set_gesture_sensitivity(struct mgos_apds9960 *sensor, uint8_t threshold, uint8_t sensitivity);
+
+/*
+ * Copy the most recently recognized gesture, including its confidence, speed
+ * and duration, to *gesture. This is meant to be called from the `gesture`
+ * handler. Returns true on success, or false otherwise.
+ */
+bool mgos_apds9960_get_last_gesture(struct mgos_apds9960 *sensor, struct mgos_apds9960_gesture *gesture);
+
+/*
+ * Run one step of the gesture decoder: drain the datasets currently in the
+ * gesture FIFO and feed them to the decoder, without blocking. Decoder state is
+ * kept in the sensor between calls, so this is meant to be called on every
+ * gesture interrupt or timer tick. Returns true if the gesture sensor could be
+ * read. Note: the return value does not correlate with a successful gesture
+ * computation! `APDS9960_DIR_NONE` is written to *direction while the gesture
+ * is still undecided.
  */
 bool mgos_apds9960_read_gesture(struct mgos_apds9960 *sensor, enum mgos_apds9960_direction_t *direction);
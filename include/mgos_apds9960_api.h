@@ -24,26 +24,97 @@ extern "C" {
 
 struct mgos_apds9960;
 
+/* STATUS register (0x93) bits */
+#define APDS9960_STATUS_CPSAT              0x80
+#define APDS9960_STATUS_PGSAT              0x40
+#define APDS9960_STATUS_PINT               0x20
+#define APDS9960_STATUS_AINT               0x10
+#define APDS9960_STATUS_GINT               0x04
+#define APDS9960_STATUS_PVALID             0x02
+#define APDS9960_STATUS_AVALID             0x01
+
+/* A single color sample, CDATA..BDATA from one integration cycle */
+struct mgos_apds9960_rgbc {
+  uint16_t clear;
+  uint16_t red;
+  uint16_t green;
+  uint16_t blue;
+};
+
+/* One gesture FIFO dataset */
+struct mgos_apds9960_gesture_dataset {
+  uint8_t up;
+  uint8_t down;
+  uint8_t left;
+  uint8_t right;
+};
+
+/* Read position of a consumer of the gesture dataset stream */
+struct mgos_apds9960_gesture_cursor {
+  uint32_t pos;
+  uint32_t lost;    // Datasets overwritten before this consumer got to them
+};
+
+/* Outcome of gesture FIFO drains, see mgos_apds9960_get_gesture_drain_stats() */
+struct mgos_apds9960_gesture_drain_stats {
+  uint8_t  datasets;          // Datasets read by the last drain
+  bool     overflow;          // GFOV was set on the last drain
+  uint32_t lost;              // Estimated datasets lost on the last drain (at least 1 on overflow)
+  uint32_t lost_total;        // Estimated datasets lost since sensor creation
+  uint8_t  fifo_threshold;    // GFIFOTH currently in effect, in datasets
+  uint32_t irq_latency_us;    // Last gesture interrupt to drain latency
+};
+
+/* Bus traffic generated by one sensor, see mgos_apds9960_get_i2c_stats() */
+struct mgos_apds9960_i2c_stats {
+  uint32_t transactions;
+  uint32_t errors;            // Failed transactions, NACKs included
+  uint32_t bytes_read;
+  uint32_t bytes_written;     // Register addresses included
+  uint64_t latency_total_us;  // Time spent in the I2C primitives
+  uint32_t latency_max_us;
+};
+
 bool mgos_apds9960_init(struct mgos_apds9960 *sensor);
+/* As mgos_apds9960_init(), but skips the reset when the device is known to
+ * be fresh out of power-on-reset. Sensor creation and mgos_apds9960_resync()
+ * use it when CONFIG1 reads back its reset value, without the reserved bit
+ * that initialization sets. */
+bool mgos_apds9960_init_after_por(struct mgos_apds9960 *sensor);
 bool mgos_apds9960_enable(struct mgos_apds9960 *sensor);
 bool mgos_apds9960_disable(struct mgos_apds9960 *sensor);
+/* Re-reads the configuration registers into the shadow copy. A device which
+ * has been through a power-on-reset is initialized again. */
+bool mgos_apds9960_resync(struct mgos_apds9960 *sensor);
 bool mgos_apds9960_get_mode(struct mgos_apds9960 *sensor, uint8_t *mode);
 bool mgos_apds9960_set_mode(struct mgos_apds9960 *sensor, uint8_t mode, uint8_t enable);
 bool mgos_apds9960_get_led_drive(struct mgos_apds9960 *sensor, uint8_t *drive);
 bool mgos_apds9960_set_led_drive(struct mgos_apds9960 *sensor, uint8_t drive);
 bool mgos_apds9960_get_led_boost(struct mgos_apds9960 *sensor, uint8_t *boost);
 bool mgos_apds9960_set_led_boost(struct mgos_apds9960 *sensor, uint8_t boost);
+bool mgos_apds9960_get_light_saturation_int_enable(struct mgos_apds9960 *sensor, bool *enabled);
+bool mgos_apds9960_set_light_saturation_int_enable(struct mgos_apds9960 *sensor, bool enable);
+bool mgos_apds9960_get_proximity_saturation_int_enable(struct mgos_apds9960 *sensor, bool *enabled);
+bool mgos_apds9960_set_proximity_saturation_int_enable(struct mgos_apds9960 *sensor, bool enable);
+bool mgos_apds9960_get_sleep_after_int(struct mgos_apds9960 *sensor, bool *enabled);
+bool mgos_apds9960_set_sleep_after_int(struct mgos_apds9960 *sensor, bool enable);
 bool mgos_apds9960_clear_int(struct mgos_apds9960 *sensor);
+bool mgos_apds9960_get_status(struct mgos_apds9960 *sensor, uint8_t *status);
+/* Duration of one proximity/wait/ALS cycle as currently configured, in usec */
+bool mgos_apds9960_get_cycle_time(struct mgos_apds9960 *sensor, uint32_t *usecs);
 
 /* Light sensor API calls */
 bool mgos_apds9960_enable_light_sensor(struct mgos_apds9960 *sensor);
 bool mgos_apds9960_disable_light_sensor(struct mgos_apds9960 *sensor);
 bool mgos_apds9960_get_light_gain(struct mgos_apds9960 *sensor, uint8_t *gain);
 bool mgos_apds9960_set_light_gain(struct mgos_apds9960 *sensor, uint8_t gain);
+bool mgos_apds9960_get_light_integration_time(struct mgos_apds9960 *sensor, uint8_t *atime);
+bool mgos_apds9960_set_light_integration_time(struct mgos_apds9960 *sensor, uint8_t atime);
 bool mgos_apds9960_get_light_int_low_threshold(struct mgos_apds9960 *sensor, uint16_t *threshold);
 bool mgos_apds9960_set_light_int_low_threshold(struct mgos_apds9960 *sensor, uint16_t threshold);
 bool mgos_apds9960_get_light_int_high_threshold(struct mgos_apds9960 *sensor, uint16_t *threshold);
 bool mgos_apds9960_set_light_int_high_threshold(struct mgos_apds9960 *sensor, uint16_t threshold);
+bool mgos_apds9960_set_light_int_thresholds(struct mgos_apds9960 *sensor, uint16_t low, uint16_t high);
 bool mgos_apds9960_get_light_int_enable(struct mgos_apds9960 *sensor, bool *enabled);
 bool mgos_apds9960_set_light_int_enable(struct mgos_apds9960 *sensor, bool enable);
 bool mgos_apds9960_get_light_int(struct mgos_apds9960 *sensor, bool *firing);
@@ -51,6 +122,7 @@ bool mgos_apds9960_read_ambient_light(struct mgos_apds9960 *sensor, uint16_t *va
 bool mgos_apds9960_read_red_light(struct mgos_apds9960 *sensor, uint16_t *val);
 bool mgos_apds9960_read_green_light(struct mgos_apds9960 *sensor, uint16_t *val);
 bool mgos_apds9960_read_blue_light(struct mgos_apds9960 *sensor, uint16_t *val);
+bool mgos_apds9960_read_rgbc(struct mgos_apds9960 *sensor, struct mgos_apds9960_rgbc *rgbc);
 
 
 /* Proximity sensor API calls */
@@ -62,6 +134,9 @@ bool mgos_apds9960_get_proximity_int_low_threshold(struct mgos_apds9960 *sensor,
 bool mgos_apds9960_set_proximity_int_low_threshold(struct mgos_apds9960 *sensor, uint8_t threshold);
 bool mgos_apds9960_get_proximity_int_high_threshold(struct mgos_apds9960 *sensor, uint8_t *threshold);
 bool mgos_apds9960_set_proximity_int_high_threshold(struct mgos_apds9960 *sensor, uint8_t threshold);
+bool mgos_apds9960_set_proximity_int_thresholds(struct mgos_apds9960 *sensor, uint8_t low, uint8_t high);
+bool mgos_apds9960_get_proximity_int_persistence(struct mgos_apds9960 *sensor, uint8_t *persistence);
+bool mgos_apds9960_set_proximity_int_persistence(struct mgos_apds9960 *sensor, uint8_t persistence);
 bool mgos_apds9960_get_proximity_int_enable(struct mgos_apds9960 *sensor, bool *enabled);
 bool mgos_apds9960_set_proximity_int_enable(struct mgos_apds9960 *sensor, bool enable);
 bool mgos_apds9960_get_proximity_int(struct mgos_apds9960 *sensor, bool *firing);
@@ -89,8 +164,22 @@ bool mgos_apds9960_get_gesture_wait_time(struct mgos_apds9960 *sensor, uint8_t *
 bool mgos_apds9960_set_gesture_wait_time(struct mgos_apds9960 *sensor, uint8_t time);
 bool mgos_apds9960_get_gesture_mode(struct mgos_apds9960 *sensor, uint8_t *mode);
 bool mgos_apds9960_set_gesture_mode(struct mgos_apds9960 *sensor, uint8_t mode);
+bool mgos_apds9960_get_gesture_fifo_threshold(struct mgos_apds9960 *sensor, uint8_t *threshold);
+bool mgos_apds9960_set_gesture_fifo_threshold(struct mgos_apds9960 *sensor, uint8_t threshold);
+bool mgos_apds9960_set_gesture_fifo_autotune(struct mgos_apds9960 *sensor, bool enable);
+bool mgos_apds9960_get_gesture_drain_stats(struct mgos_apds9960 *sensor, struct mgos_apds9960_gesture_drain_stats *stats);
 bool mgos_apds9960_get_gesture_fifo(struct mgos_apds9960 *sensor, uint8_t *fifo, uint8_t *bytes_read);
 
+/* Gesture dataset stream: the gesture FIFO is drained into a per-sensor ring
+ * buffer, which consumers read in place through a cursor. */
+void mgos_apds9960_gesture_cursor_init(struct mgos_apds9960 *sensor, struct mgos_apds9960_gesture_cursor *cursor);
+size_t mgos_apds9960_gesture_peek(struct mgos_apds9960 *sensor, struct mgos_apds9960_gesture_cursor *cursor, const struct mgos_apds9960_gesture_dataset **data);
+void mgos_apds9960_gesture_consume(struct mgos_apds9960_gesture_cursor *cursor, size_t count);
+uint32_t mgos_apds9960_get_gesture_fifo_overflows(struct mgos_apds9960 *sensor);
+
+bool mgos_apds9960_get_i2c_stats(struct mgos_apds9960 *sensor, struct mgos_apds9960_i2c_stats *stats);
+bool mgos_apds9960_reset_i2c_stats(struct mgos_apds9960 *sensor);
+
 #ifdef __cplusplus
 }
 #endif
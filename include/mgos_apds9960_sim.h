@@ -0,0 +1,86 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Simulated APDS9960 register file, for running the driver on a host without
+ * a sensor attached. When built with MGOS_APDS9960_SIM defined, the library
+ * provides the `mgos_i2c_*` primitives the driver uses itself, and routes them
+ * to simulated devices created with `mgos_apds9960_sim_create()`.
+ *
+ * The simulation models the register map with auto-increment, the operational
+ * state machine (proximity, gesture, wait and ALS engines, with their timing
+ * derived from ATIME/WTIME/WLONG/PPULSE/GPULSE/GWTIME), interrupt persistence,
+ * STATUS/GSTATUS and the interrupt clear special functions, the 32-dataset
+ * gesture FIFO with GFLVL/GFIFOTH/GFOV, and sleep-after-interrupt. Simulated
+ * time only moves when `mgos_apds9960_sim_advance()` is called.
+ */
+
+#pragma once
+#ifdef MGOS_APDS9960_SIM
+#include "mgos_apds9960.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MGOS_APDS9960_SIM_MAX_DEVICES    8
+
+struct mgos_apds9960_sim;
+
+/* Signal presented to the photodiodes at a point in time */
+struct mgos_apds9960_sim_input {
+  uint16_t                             clear;     // Counts per 2.78ms integration step at 1x gain
+  uint16_t                             red;
+  uint16_t                             green;
+  uint16_t                             blue;
+  uint8_t                              proximity; // Counts before offset correction
+  struct mgos_apds9960_gesture_dataset gesture;   // Counts before offset correction
+};
+
+/* Fills in the input at simulated time `time_us` */
+typedef void (*mgos_apds9960_sim_waveform_t)(int64_t time_us, struct mgos_apds9960_sim_input *input, void *arg);
+
+/* Bus traffic seen by a simulated device, bus time assumes 100kHz */
+struct mgos_apds9960_sim_stats {
+  uint32_t transactions;
+  uint32_t bytes_read;
+  uint32_t bytes_written;
+  uint32_t bus_time_us;
+};
+
+struct mgos_apds9960_sim *mgos_apds9960_sim_create(struct mgos_i2c *i2c, uint8_t i2caddr);
+void mgos_apds9960_sim_destroy(struct mgos_apds9960_sim **sim);
+
+/* Scripting the signal: either a constant input, or a waveform callback */
+void mgos_apds9960_sim_set_input(struct mgos_apds9960_sim *sim, const struct mgos_apds9960_sim_input *input);
+void mgos_apds9960_sim_set_waveform(struct mgos_apds9960_sim *sim, mgos_apds9960_sim_waveform_t waveform, void *arg);
+
+/* Move simulated time forward for all devices */
+void mgos_apds9960_sim_advance(uint32_t usecs);
+int64_t mgos_apds9960_sim_time_us(void);
+
+/* Inspection and fault injection */
+bool mgos_apds9960_sim_int_asserted(struct mgos_apds9960_sim *sim);
+uint8_t mgos_apds9960_sim_get_reg(struct mgos_apds9960_sim *sim, uint8_t reg);
+void mgos_apds9960_sim_set_nack(struct mgos_apds9960_sim *sim, bool nack);
+void mgos_apds9960_sim_get_stats(struct mgos_apds9960_sim *sim, struct mgos_apds9960_sim_stats *stats);
+void mgos_apds9960_sim_reset_stats(struct mgos_apds9960_sim *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MGOS_APDS9960_SIM
@@ -17,8 +17,20 @@
 #include "mgos_apds9960_internal.h"
 
 struct mgos_apds9960 *mgos_apds9960_create(struct mgos_i2c *i2c, uint8_t i2caddr) {
+  int irq_pin = mgos_sys_config_get_apds9960_irq_pin();
+
+  return mgos_apds9960_create_mux(i2c, i2caddr, irq_pin > 0 ? irq_pin : -1, NULL, NULL);
+}
+
+struct mgos_apds9960 *mgos_apds9960_create_irq(struct mgos_i2c *i2c, uint8_t i2caddr, int irq_pin) {
+  return mgos_apds9960_create_mux(i2c, i2caddr, irq_pin, NULL, NULL);
+}
+
+struct mgos_apds9960 *mgos_apds9960_create_mux(struct mgos_i2c *i2c, uint8_t i2caddr, int irq_pin, mgos_apds9960_bus_select_t bus_select, void *arg) {
+  struct mgos_apds9960_calibration cal;
   struct mgos_apds9960 *sensor = NULL;
-  uint8_t id = 0;
+  uint8_t probe[APDS9960_ID - APDS9960_CONFIG1 + 1];
+  uint8_t id;
 
   if (!i2c) {
     return NULL;
@@ -29,40 +41,61 @@ struct mgos_apds9960 *mgos_apds9960_create(struct mgos_i2c *i2c, uint8_t i2caddr
     return NULL;
   }
 
-  memset(sensor, 0, sizeof(struct mgos_apds9960));
-  sensor->i2caddr           = i2caddr;
-  sensor->i2c               = i2c;
-  sensor->light_handler     = NULL;
-  sensor->proximity_handler = NULL;
-  sensor->gesture_handler   = NULL;
-  mgos_apds9960_reset_gesture_data(sensor);
-
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_ID, &id)) {
+  sensor->i2caddr                = i2caddr;
+  sensor->i2c                    = i2c;
+  sensor->irq_pin                = irq_pin;
+  sensor->bus_select             = bus_select;
+  sensor->bus_select_arg         = arg;
+  sensor->light_handler          = NULL;
+  sensor->proximity_handler      = NULL;
+  sensor->gesture_handler        = NULL;
+  sensor->gesture_stream_handler = NULL;
+  sensor->gesture_trajectory.threshold            = APDS9960_GESTURE_THRESHOLD_OUT;
+  sensor->gesture_trajectory.sensitivity          = APDS9960_GESTURE_SENSITIVITY_1;
+  sensor->gesture_trajectory.near_far_sensitivity = APDS9960_GESTURE_SENSITIVITY_2;
+  mgos_apds9960_set_gesture_engine(sensor, NULL, NULL);
+  mgos_apds9960_set_lux_coefficients(sensor, NULL);
+
+  // CONFIG1 through ID in one read: besides the ID, this tells whether the
+  // device is fresh out of power-on-reset and needs no reset write
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_CONFIG1, probe, sizeof(probe)) != sizeof(probe)) {
     LOG(LL_ERROR, ("Cannot read from device at I2C 0x%02x", sensor->i2caddr));
+    mgos_apds9960_bus_forget(sensor);
     free(sensor);
-    return false;
+    return NULL;
   }
+  id = probe[APDS9960_ID - APDS9960_CONFIG1];
   if (!(id == APDS9960_ID_1 || id == APDS9960_ID_2)) {
     LOG(LL_ERROR, ("Device at I2C 0x%02x does not identify as an APDS9960", sensor->i2caddr));
+    mgos_apds9960_bus_forget(sensor);
     free(sensor);
-    return false;
+    return NULL;
   }
 
-  if (!mgos_apds9960_init(sensor)) {
+  mgos_apds9960_reset_gesture_data(sensor);
+  if (!((probe[0] & APDS9960_CONFIG1_INIT) ? mgos_apds9960_init(sensor) : mgos_apds9960_init_after_por(sensor))) {
     LOG(LL_ERROR, ("Could not initialize APDS9960 at I2C 0x%02x", sensor->i2caddr));
+    mgos_apds9960_bus_forget(sensor);
     free(sensor);
-    return false;
+    return NULL;
+  }
+
+  // The stored calibration is one set, for the sensor at the configured
+  // address. Sensors behind a multiplexer may share that address.
+  if (!bus_select && i2caddr == mgos_sys_config_get_apds9960_i2caddr() && mgos_apds9960_load_calibration(&cal) &&
+      !mgos_apds9960_set_calibration(sensor, &cal)) {
+    LOG(LL_WARN, ("Could not restore APDS9960 calibration"));
   }
 
   // Install interrupt handler
-  if (mgos_sys_config_get_apds9960_irq_pin() > 0) {
-    mgos_gpio_set_mode(mgos_sys_config_get_apds9960_irq_pin(), MGOS_GPIO_MODE_INPUT);
-    mgos_gpio_set_pull(mgos_sys_config_get_apds9960_irq_pin(), MGOS_GPIO_PULL_UP);
-    mgos_gpio_set_int_handler(mgos_sys_config_get_apds9960_irq_pin(), MGOS_GPIO_INT_EDGE_NEG, mgos_apds9960_irq, sensor);
-    mgos_gpio_enable_int(mgos_sys_config_get_apds9960_irq_pin());
+  if (sensor->irq_pin >= 0) {
+    mgos_gpio_set_mode(sensor->irq_pin, MGOS_GPIO_MODE_INPUT);
+    mgos_gpio_set_pull(sensor->irq_pin, MGOS_GPIO_PULL_UP);
+    mgos_gpio_set_int_handler(sensor->irq_pin, MGOS_GPIO_INT_EDGE_NEG, mgos_apds9960_irq, sensor);
+    mgos_gpio_enable_int(sensor->irq_pin);
   }
 
-  LOG(LL_INFO, ("APDS9960 initialized at I2C 0x%02x", sensor->i2caddr));
+  LOG(LL_INFO, ("APDS9960 initialized at I2C 0x%02x, IRQ pin %d", sensor->i2caddr, sensor->irq_pin));
   return sensor;
 }
 
@@ -70,37 +103,57 @@ void mgos_apds9960_destroy(struct mgos_apds9960 **sensor) {
   if (!*sensor) {
     return;
   }
+  if ((*sensor)->irq_pin >= 0) {
+    mgos_gpio_disable_int((*sensor)->irq_pin);
+    mgos_gpio_remove_int_handler((*sensor)->irq_pin, NULL, NULL);
+  }
+  mgos_apds9960_irq_group_remove((*sensor)->irq_group, *sensor);
+  mgos_apds9960_sampler_remove((*sensor)->sampler, *sensor);
   mgos_apds9960_disable(*sensor);
+  if ((*sensor)->gesture_timer != MGOS_INVALID_TIMER_ID) {
+    mgos_clear_timer((*sensor)->gesture_timer);
+  }
+  if ((*sensor)->sample_timer != MGOS_INVALID_TIMER_ID) {
+    mgos_clear_timer((*sensor)->sample_timer);
+  }
+  mgos_apds9960_async_cancel(*sensor);
+  mgos_apds9960_bus_forget(*sensor);
 
-  free(*sensor);
+  // A pending interrupt worker still holds the pointer, and frees it instead
+  if ((*sensor)->irq_scheduled) {
+    (*sensor)->destroyed = true;
+  } else {
+    free(*sensor);
+  }
   *sensor = NULL;
   return;
 }
 
 bool mgos_apds9960_read_light(struct mgos_apds9960 *sensor, uint16_t *c, uint16_t *r, uint16_t *g, uint16_t *b) {
+  struct mgos_apds9960_rgbc rgbc;
+
   if (!sensor) {
     return false;
   }
+  if (!c && !r && !g && !b) {
+    return true;
+  }
+
+  if (!mgos_apds9960_read_rgbc(sensor, &rgbc)) {
+    return false;
+  }
 
   if (c) {
-    if (!mgos_apds9960_read_ambient_light(sensor, c)) {
-      return false;
-    }
+    *c = rgbc.clear;
   }
   if (r) {
-    if (!mgos_apds9960_read_red_light(sensor, r)) {
-      return false;
-    }
+    *r = rgbc.red;
   }
   if (g) {
-    if (!mgos_apds9960_read_green_light(sensor, g)) {
-      return false;
-    }
+    *g = rgbc.green;
   }
   if (b) {
-    if (!mgos_apds9960_read_blue_light(sensor, b)) {
-      return false;
-    }
+    *b = rgbc.blue;
   }
   return true;
 }
@@ -115,20 +168,11 @@ bool mgos_apds9960_read_proximity(struct mgos_apds9960 *sensor, uint8_t *val) {
   return true;
 }
 
-bool mgos_apds9960_is_gesture_available(struct mgos_apds9960 *sensor) {
-  uint8_t val;
-
+uint8_t mgos_apds9960_get_irq_status(struct mgos_apds9960 *sensor) {
   if (!sensor) {
-    return false;
+    return 0;
   }
-
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GSTATUS, &val)) {
-    return false;
-  }
-
-  val &= APDS9960_GVALID;
-
-  return val == 1;
+  return sensor->irq_status;
 }
 
 bool mgos_apds9960_set_callback_light(struct mgos_apds9960 *sensor, uint16_t low_threshold, uint16_t high_threshold, mgos_apds9960_light_event_t handler) {
@@ -149,10 +193,53 @@ bool mgos_apds9960_set_callback_light(struct mgos_apds9960 *sensor, uint16_t low
     return false;
   }
 
+  sensor->light_change  = false;
   sensor->light_handler = handler;
   return true;
 }
 
+static void mgos_apds9960_light_recenter(struct mgos_apds9960 *sensor, uint16_t clear) {
+  uint32_t delta = (uint32_t)clear * sensor->light_delta_pct / 100;
+  uint32_t low, high;
+
+  if (delta < sensor->light_delta) {
+    delta = sensor->light_delta;
+  }
+  if (delta == 0) {
+    delta = 1;
+  }
+  low  = clear > delta ? clear - delta : 0;
+  high = clear + delta < 0xFFFF ? clear + delta : 0xFFFF;
+
+  if (!mgos_apds9960_set_light_int_thresholds(sensor, low, high)) {
+    LOG(LL_ERROR, ("Could not set APDS9960 light thresholds at I2C 0x%02x", sensor->i2caddr));
+  }
+}
+
+bool mgos_apds9960_set_callback_light_change(struct mgos_apds9960 *sensor, uint16_t delta, uint8_t delta_pct, mgos_apds9960_light_event_t handler) {
+  if (!sensor || !handler) {
+    return false;
+  }
+
+  sensor->light_handler = NULL;
+  if (!mgos_apds9960_enable_light_sensor(sensor)) {
+    return false;
+  }
+  // Low above high: the first conversion falls outside and interrupts
+  if (!mgos_apds9960_set_light_int_thresholds(sensor, 0xFFFF, 0)) {
+    return false;
+  }
+  if (!mgos_apds9960_set_light_int_enable(sensor, true)) {
+    return false;
+  }
+
+  sensor->light_change    = true;
+  sensor->light_delta     = delta;
+  sensor->light_delta_pct = delta_pct;
+  sensor->light_handler   = handler;
+  return true;
+}
+
 bool mgos_apds9960_set_callback_proximity(struct mgos_apds9960 *sensor, uint8_t low_threshold, uint8_t high_threshold, mgos_apds9960_proximity_event_t handler) {
   if (!sensor) {
     return false;
@@ -171,10 +258,125 @@ bool mgos_apds9960_set_callback_proximity(struct mgos_apds9960 *sensor, uint8_t
     return false;
   }
 
+  sensor->presence_handler  = NULL;
   sensor->proximity_handler = handler;
   return true;
 }
 
+bool mgos_apds9960_set_callback_saturation(struct mgos_apds9960 *sensor, uint8_t sources, bool auto_adjust, mgos_apds9960_saturation_event_t handler) {
+  if (!sensor || (sources & ~(APDS9960_STATUS_CPSAT | APDS9960_STATUS_PGSAT))) {
+    return false;
+  }
+
+  sensor->saturation_sources = 0;
+  if (!mgos_apds9960_set_light_saturation_int_enable(sensor, sources & APDS9960_STATUS_CPSAT)) {
+    return false;
+  }
+  if (!mgos_apds9960_set_proximity_saturation_int_enable(sensor, sources & APDS9960_STATUS_PGSAT)) {
+    return false;
+  }
+
+  sensor->saturation_handler = handler;
+  sensor->saturation_auto    = auto_adjust;
+  sensor->saturation_sources = sources;
+  return true;
+}
+
+// One step less sensitive: proximity gain first, then LED drive (higher
+// LDRIVE values are less current). False if both are at their minimum.
+static bool mgos_apds9960_proximity_step_down(struct mgos_apds9960 *sensor) {
+  uint8_t gain, drive;
+
+  if (!mgos_apds9960_get_proximity_gain(sensor, &gain) || !mgos_apds9960_get_led_drive(sensor, &drive)) {
+    return false;
+  }
+  if (gain > APDS9960_PGAIN_1X) {
+    return mgos_apds9960_set_proximity_gain(sensor, gain - 1);
+  }
+  if (drive < APDS9960_LED_DRIVE_12_5MA) {
+    return mgos_apds9960_set_led_drive(sensor, drive + 1);
+  }
+  return false;
+}
+
+static void mgos_apds9960_saturation_adjust(struct mgos_apds9960 *sensor, uint8_t status) {
+  if ((status & APDS9960_STATUS_CPSAT) && !mgos_apds9960_als_step_down(sensor)) {
+    LOG(LL_WARN, ("APDS9960 at I2C 0x%02x saturated at the least sensitive light range", sensor->i2caddr));
+    sensor->saturation_sources &= ~APDS9960_STATUS_CPSAT;
+    mgos_apds9960_set_light_saturation_int_enable(sensor, false);
+  }
+  if ((status & APDS9960_STATUS_PGSAT) && !mgos_apds9960_proximity_step_down(sensor)) {
+    LOG(LL_WARN, ("APDS9960 at I2C 0x%02x saturated at the least proximity gain and LED drive", sensor->i2caddr));
+    sensor->saturation_sources &= ~APDS9960_STATUS_PGSAT;
+    mgos_apds9960_set_proximity_saturation_int_enable(sensor, false);
+  }
+}
+
+// Far: the window is [0, near], so only an approaching target interrupts.
+// Near: it is [far, 255], which PDATA cannot exceed, so only release does.
+static bool mgos_apds9960_presence_arm(struct mgos_apds9960 *sensor, bool near) {
+  if (near) {
+    return mgos_apds9960_set_proximity_int_thresholds(sensor, sensor->presence_far_threshold, 255);
+  }
+  return mgos_apds9960_set_proximity_int_thresholds(sensor, 0, sensor->presence_near_threshold);
+}
+
+static void mgos_apds9960_presence_update(struct mgos_apds9960 *sensor, uint8_t proximity) {
+  bool near;
+
+  if (!sensor->presence_near && proximity > sensor->presence_near_threshold) {
+    near = true;
+  } else if (sensor->presence_near && proximity < sensor->presence_far_threshold) {
+    near = false;
+  } else {
+    return;
+  }
+
+  if (!mgos_apds9960_presence_arm(sensor, near)) {
+    LOG(LL_ERROR, ("Could not set APDS9960 proximity thresholds at I2C 0x%02x", sensor->i2caddr));
+    return;
+  }
+  sensor->presence_near = near;
+  sensor->presence_handler(near ? APDS9960_DIR_NEAR : APDS9960_DIR_FAR, proximity);
+}
+
+bool mgos_apds9960_set_callback_presence(struct mgos_apds9960 *sensor, uint8_t far_threshold, uint8_t near_threshold, uint8_t persistence,
+                                         mgos_apds9960_presence_event_t handler) {
+  // PPERS 0 would interrupt on every cycle
+  if (!sensor || !handler || far_threshold >= near_threshold || persistence < 1 || persistence > 15) {
+    return false;
+  }
+
+  sensor->proximity_handler       = NULL;
+  sensor->presence_handler        = NULL;
+  sensor->presence_near           = false;
+  sensor->presence_far_threshold  = far_threshold;
+  sensor->presence_near_threshold = near_threshold;
+
+  if (!mgos_apds9960_enable_proximity_sensor(sensor)) {
+    return false;
+  }
+  if (!mgos_apds9960_set_proximity_int_persistence(sensor, persistence)) {
+    return false;
+  }
+  if (!mgos_apds9960_presence_arm(sensor, false)) {
+    return false;
+  }
+  if (!mgos_apds9960_set_proximity_int_enable(sensor, true)) {
+    return false;
+  }
+
+  sensor->presence_handler = handler;
+  return true;
+}
+
+enum mgos_apds9960_direction_t mgos_apds9960_get_presence(struct mgos_apds9960 *sensor) {
+  if (!sensor || !sensor->presence_handler) {
+    return APDS9960_DIR_NONE;
+  }
+  return sensor->presence_near ? APDS9960_DIR_NEAR : APDS9960_DIR_FAR;
+}
+
 bool mgos_apds9960_set_callback_gesture(struct mgos_apds9960 *sensor, mgos_apds9960_gesture_event_t handler) {
   if (!sensor) {
     return false;
@@ -203,143 +405,122 @@ bool mgos_apds9960_set_callback_gesture(struct mgos_apds9960 *sensor, mgos_apds9
   return true;
 }
 
-void mgos_apds9960_reset_gesture_data(struct mgos_apds9960 *sensor) {
-  uint8_t fifo[128];
-  uint8_t bytes_read;
+bool mgos_apds9960_set_callback_gesture_stream(struct mgos_apds9960 *sensor, mgos_apds9960_gesture_stream_event_t handler) {
+  if (!sensor) {
+    return false;
+  }
+
+  if (!mgos_apds9960_enable_gesture_sensor(sensor)) {
+    return false;
+  }
+  if (!mgos_apds9960_set_gesture_int_enable(sensor, true)) {
+    return false;
+  }
+
+  sensor->gesture_stream_handler = handler;
+  return true;
+}
+
+// GPIO interrupt handler: only latches the event, all I2C work is deferred to
+// mgos_apds9960_irq_worker() so the interrupt dispatch returns immediately.
+// Edges arriving while the worker is still pending are coalesced, as the
+// worker services everything the device has flagged in its STATUS register.
+void mgos_apds9960_irq(int pin, void *arg) {
+  struct mgos_apds9960 *sensor = (struct mgos_apds9960 *)arg;
 
   if (!sensor) {
+    LOG(LL_ERROR, ("Interrupt fired for APDS9960, but no sensor to poll"));
     return;
   }
-  sensor->up_cnt    = 0;
-  sensor->down_cnt  = 0;
-  sensor->left_cnt  = 0;
-  sensor->right_cnt = 0;
-  while (mgos_apds9960_is_gesture_available(sensor)) {
-    mgos_apds9960_get_gesture_fifo(sensor, fifo, &bytes_read);
-    if (bytes_read > 0) {
-      LOG(LL_INFO, ("Flushed %d bytes from Gesture FIFO", bytes_read));
-    }
+  if (sensor->irq_scheduled) {
+    return;
   }
-  return;
+
+  sensor->irq_scheduled = true;
+  sensor->irq_us        = mgos_uptime_micros();
+  if (!mgos_invoke_cb(mgos_apds9960_irq_worker, sensor, false)) {
+    LOG(LL_ERROR, ("Could not schedule APDS9960 interrupt worker"));
+    sensor->irq_scheduled = false;
+  }
+  (void)pin;
 }
 
-bool mgos_apds9960_read_gesture(struct mgos_apds9960 *sensor, enum mgos_apds9960_direction_t *direction) {
-  uint8_t fifo[128];
-  uint8_t bytes_read;
-  double  start           = 0;
-  int     up_down_diff    = 0;
-  int     left_right_diff = 0;
-  enum mgos_apds9960_direction_t gestureReceived;
+// Triage reads STATUS and, when light or proximity handlers are installed,
+// the RGBC and PDATA registers which directly follow it (0x93-0x9C), all in
+// one burst. Handlers are then dispatched from that snapshot. Returns true if
+// the sensor had an interrupt pending.
+bool mgos_apds9960_irq_service(struct mgos_apds9960 *sensor, int64_t irq_us) {
+  uint8_t data[APDS9960_PDATA - APDS9960_STATUS + 1];
+  int     len = 1;
+  uint8_t status, saturated;
 
-  if (!sensor || !direction) {
+  if (!sensor) {
     return false;
   }
 
-  start = mg_time();
-  while (mgos_apds9960_is_gesture_available(sensor)) {
-    double now = 0;
-    gestureReceived = APDS9960_DIR_NONE;
-
-    mgos_msleep(50);
-    if (!mgos_apds9960_get_gesture_fifo(sensor, fifo, &bytes_read)) {
-      LOG(LL_ERROR, ("Could not read Gesture FIFO"));
-      return false;
-    }
+  if (sensor->light_handler || sensor->proximity_handler || sensor->presence_handler) {
+    len = sizeof(data);
+  }
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_STATUS, data, len) != len) {
+    LOG(LL_ERROR, ("Could not read APDS9960 status"));
+    mgos_apds9960_clear_int(sensor);
+    return false;
+  }
+  status             = data[0];
+  sensor->irq_status = status;
+  if (!(status & (APDS9960_STATUS_AINT | APDS9960_STATUS_PINT | APDS9960_STATUS_GINT | APDS9960_STATUS_CPSAT | APDS9960_STATUS_PGSAT))) {
+    return false;
+  }
+  LOG(LL_INFO, ("Interrupt fired for APDS9960: status=0x%02x", status));
 
-    LOG(LL_INFO, ("Read %u bytes from Gesture FIFO", bytes_read));
-    for (int i = 0; i < bytes_read / 4; i++) {
-      LOG(LL_INFO, ("U=%u D=%u L=%u R=%u", fifo[i*4+0], fifo[i*4+1], fifo[i*4+2], fifo[i*4+3]));
-      if (abs((int)fifo[i * 4 + 0] - (int)fifo[i * 4 + 1]) > 13) {
-        up_down_diff += (int)fifo[i * 4 + 0] - (int)fifo[i * 4 + 1];
-      }
-      if (abs((int)fifo[i * 4 + 2] - (int)fifo[i * 4 + 3]) > 13) {
-        left_right_diff += (int)fifo[i * 4 + 2] - (int)fifo[i * 4 + 3];
-      }
+  // Saturated readings are reported as such, not as light or proximity data
+  saturated = status & sensor->saturation_sources;
+  if (saturated) {
+    if (sensor->saturation_auto) {
+      mgos_apds9960_saturation_adjust(sensor, saturated);
     }
-    LOG(LL_INFO, ("up_down_diff=%d left_right_diff=%d", up_down_diff, left_right_diff));
-
-    if (up_down_diff < 0) {
-      if (sensor->down_cnt > 0) {
-        gestureReceived = APDS9960_DIR_UP;
-      } else {
-        sensor->up_cnt++;
-      }
-    } else if (up_down_diff > 0) {
-      if (sensor->up_cnt > 0) {
-        gestureReceived = APDS9960_DIR_DOWN;
-      } else {
-        sensor->down_cnt++;
-      }
+    if (sensor->saturation_handler) {
+      sensor->saturation_handler(status);
     }
+  }
 
-    if (left_right_diff < 0) {
-      if (sensor->right_cnt > 0) {
-        gestureReceived = APDS9960_DIR_LEFT;
-      } else {
-        sensor->left_cnt++;
-      }
-    } else if (left_right_diff > 0) {
-      if (sensor->left_cnt > 0) {
-        gestureReceived = APDS9960_DIR_RIGHT;
-      } else {
-        sensor->right_cnt++;
-      }
+  if ((status & APDS9960_STATUS_AINT) && sensor->light_handler) {
+    struct mgos_apds9960_rgbc rgbc;
+    mgos_apds9960_decode_rgbc(&data[APDS9960_CDATAL - APDS9960_STATUS], &rgbc);
+    // Saturated readings move the window too, or every following conversion
+    // would fall outside it again
+    if (sensor->light_change) {
+      mgos_apds9960_light_recenter(sensor, rgbc.clear);
     }
-
-    if (gestureReceived != APDS9960_DIR_NONE) {
-      mgos_apds9960_reset_gesture_data(sensor);
-      *direction = gestureReceived;
-      return true;
-    }
-
-    now = mg_time();
-    LOG(LL_INFO, ("start=%.4f now=%.4f", start, now));
-    if (now - start > (0.300)) {
-      LOG(LL_INFO, ("timeout"));
-      mgos_apds9960_reset_gesture_data(sensor);
-      *direction = APDS9960_DIR_NONE;
-      return false;
+    if (!(saturated & APDS9960_STATUS_CPSAT)) {
+      sensor->light_handler(rgbc.clear, rgbc.red, rgbc.green, rgbc.blue);
     }
   }
-  LOG(LL_WARN, ("No Gesture FIFO data available"));
-  return false;
+  if ((status & APDS9960_STATUS_PINT) && !(saturated & APDS9960_STATUS_PGSAT) && sensor->proximity_handler) {
+    sensor->proximity_handler(data[APDS9960_PDATA - APDS9960_STATUS]);
+  }
+  if ((status & APDS9960_STATUS_PINT) && !(saturated & APDS9960_STATUS_PGSAT) && sensor->presence_handler) {
+    mgos_apds9960_presence_update(sensor, data[APDS9960_PDATA - APDS9960_STATUS]);
+  }
+  if ((status & APDS9960_STATUS_GINT) && (sensor->gesture_handler || sensor->gesture_stream_handler)) {
+    sensor->gesture_irq_us = irq_us;
+    mgos_apds9960_gesture_poll(sensor);
+  }
+
+  mgos_apds9960_clear_int(sensor);
+  return true;
 }
 
-void mgos_apds9960_irq(int pin, void *arg) {
+void mgos_apds9960_irq_worker(void *arg) {
   struct mgos_apds9960 *sensor = (struct mgos_apds9960 *)arg;
-  bool light_firing            = false;
-  bool proximity_firing        = false;
-  bool gesture_firing          = false;
-
-  if (!arg) {
-    LOG(LL_ERROR, ("Interrupt fired for APDS9960, but no sensor to poll"));
-  }
-
-  mgos_apds9960_get_light_int(sensor, &light_firing);
-  mgos_apds9960_get_proximity_int(sensor, &proximity_firing);
-  mgos_apds9960_get_gesture_int(sensor, &gesture_firing);
-  LOG(LL_INFO, ("Interrupt fired for APDS9960: light=%u proximity=%u gesture=%u", light_firing, proximity_firing, gesture_firing));
 
-  if (light_firing && sensor->light_handler) {
-    uint16_t clear = 0, red = 0, green = 0, blue = 0;
-    mgos_apds9960_read_light(sensor, &clear, &red, &green, &blue);
-    sensor->light_handler(clear, red, green, blue);
-  }
-  if (proximity_firing && sensor->proximity_handler) {
-    uint8_t proximity;
-    if (mgos_apds9960_read_proximity(sensor, &proximity)) {
-      sensor->proximity_handler(proximity);
-    }
+  if (!sensor) {
+    return;
   }
-  if (gesture_firing && sensor->gesture_handler) {
-    enum mgos_apds9960_direction_t direction = APDS9960_DIR_NONE;
-    if (!mgos_apds9960_read_gesture(sensor, &direction)) {
-      LOG(LL_WARN, ("Could not read gesture"));
-    } else {
-      sensor->gesture_handler(direction);
-    }
+  sensor->irq_scheduled = false;
+  if (sensor->destroyed) {
+    free(sensor);
+    return;
   }
-
-  mgos_apds9960_clear_int(sensor);
-  (void)pin;
+  mgos_apds9960_irq_service(sensor, sensor->irq_us);
 }
@@ -0,0 +1,260 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+static const uint8_t s_again_mult[] = { 1, 4, 16, 64 };
+
+// Auto-ranging steps, in order of increasing sensitivity (gain x integration
+// steps of 2.78ms). Bright light gets low gain and short integration times.
+static const struct {
+  uint8_t  again;
+  uint16_t steps;
+} s_als_ranges[] = {
+  { APDS9960_AGAIN_1X,  10  },  // 27.8ms
+  { APDS9960_AGAIN_4X,  10  },
+  { APDS9960_AGAIN_16X, 10  },
+  { APDS9960_AGAIN_16X, 37  },  // 103ms
+  { APDS9960_AGAIN_64X, 37  },
+  { APDS9960_AGAIN_64X, 144 },  // 400ms
+  { APDS9960_AGAIN_64X, 256 },  // 712ms
+};
+
+#define ALS_NUM_RANGES    (sizeof(s_als_ranges) / sizeof(s_als_ranges[0]))
+#define ALS_MAX_SENS      (64 * 256)
+
+// Open air coefficients for the RGBC sensor, after AMS design note DN40
+static const struct mgos_apds9960_lux_coef s_lux_coef_default = {
+  .r_coef    = 136,
+  .g_coef    = 1000,
+  .b_coef    = -444,
+  .ct_coef   = 3810,
+  .ct_offset = 1391,
+  .df        = 310,
+  .ga        = 1000,
+};
+
+static uint32_t mgos_apds9960_als_full_scale(uint32_t steps) {
+  return steps * 1025 > 65535 ? 65535 : steps * 1025;
+}
+
+static bool mgos_apds9960_als_range(struct mgos_apds9960 *sensor, uint8_t *again, uint32_t *steps) {
+  uint8_t control, atime;
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONTROL, &control) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_ATIME, &atime)) {
+    return false;
+  }
+  *again = control & 0b00000011;
+  *steps = 256 - atime;
+  return true;
+}
+
+static bool mgos_apds9960_als_set_range(struct mgos_apds9960 *sensor, uint8_t range) {
+  if (!mgos_apds9960_set_light_gain(sensor, s_als_ranges[range].again) ||
+      !mgos_apds9960_set_light_integration_time(sensor, 256 - s_als_ranges[range].steps)) {
+    return false;
+  }
+
+  // The conversion in flight may straddle the change, drop it
+  sensor->als_settle = 1;
+  return true;
+}
+
+// The nearest less and more sensitive ranges, -1 if there is none
+static void mgos_apds9960_als_neighbours(uint32_t sens, int *down, int *up) {
+  *down = *up = -1;
+  for (int i = 0; i < (int)ALS_NUM_RANGES; i++) {
+    uint32_t range_sens = s_again_mult[s_als_ranges[i].again] * s_als_ranges[i].steps;
+
+    if (range_sens < sens) {
+      *down = i;
+    } else if (range_sens > sens && *up < 0) {
+      *up = i;
+    }
+  }
+}
+
+// Step down one range on saturation (CPSAT, or clear within 10% of full
+// scale), and up one range if the clear count would stay below 70% of full
+// scale there. The gap between both keeps the range from oscillating.
+static bool mgos_apds9960_als_autorange(struct mgos_apds9960 *sensor, uint8_t status, uint16_t clear, uint8_t again, uint32_t steps) {
+  uint32_t sens = s_again_mult[again] * steps;
+  uint32_t full = mgos_apds9960_als_full_scale(steps);
+  int      up, down;
+
+  mgos_apds9960_als_neighbours(sens, &down, &up);
+
+  if ((status & APDS9960_STATUS_CPSAT) || clear >= full * 9 / 10) {
+    if (status & APDS9960_STATUS_CPSAT) {
+      mgos_apds9960_wireWriteByte(sensor, APDS9960_CICLEAR);
+    }
+    if (down >= 0) {
+      return mgos_apds9960_als_set_range(sensor, down);
+    }
+  } else if (up >= 0) {
+    uint32_t up_sens = s_again_mult[s_als_ranges[up].again] * s_als_ranges[up].steps;
+
+    if ((uint32_t)clear * up_sens / sens < mgos_apds9960_als_full_scale(s_als_ranges[up].steps) * 7 / 10) {
+      return mgos_apds9960_als_set_range(sensor, up);
+    }
+  }
+  return true;
+}
+
+bool mgos_apds9960_als_step_down(struct mgos_apds9960 *sensor) {
+  uint8_t  again;
+  uint32_t steps;
+  int      up, down;
+
+  if (!mgos_apds9960_als_range(sensor, &again, &steps)) {
+    return false;
+  }
+  mgos_apds9960_als_neighbours(s_again_mult[again] * steps, &down, &up);
+  if (down < 0) {
+    return false;
+  }
+  return mgos_apds9960_als_set_range(sensor, down);
+}
+
+bool mgos_apds9960_set_light_autorange(struct mgos_apds9960 *sensor, bool enable) {
+  if (!sensor) {
+    return false;
+  }
+
+  sensor->als_autorange = enable;
+  sensor->als_settle    = 0;
+  return true;
+}
+
+bool mgos_apds9960_read_light_normalized(struct mgos_apds9960 *sensor, struct mgos_apds9960_light *light) {
+  uint8_t  data[APDS9960_BDATAH - APDS9960_STATUS + 1];
+  struct mgos_apds9960_rgbc rgbc;
+  uint8_t  again;
+  uint32_t steps, sens;
+
+  if (!sensor || !light) {
+    return false;
+  }
+  memset(light, 0, sizeof(*light));
+
+  if (!mgos_apds9960_als_range(sensor, &again, &steps)) {
+    return false;
+  }
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_STATUS, data, sizeof(data)) != sizeof(data)) {
+    return false;
+  }
+  if (sensor->als_settle > 0) {
+    if (data[0] & APDS9960_STATUS_AVALID) {
+      sensor->als_settle--;
+    }
+    return true;
+  }
+  mgos_apds9960_decode_rgbc(&data[APDS9960_CDATAL - APDS9960_STATUS], &rgbc);
+
+  sens         = s_again_mult[again] * steps;
+  light->clear = (uint32_t)rgbc.clear * ALS_MAX_SENS / sens;
+  light->red   = (uint32_t)rgbc.red * ALS_MAX_SENS / sens;
+  light->green = (uint32_t)rgbc.green * ALS_MAX_SENS / sens;
+  light->blue  = (uint32_t)rgbc.blue * ALS_MAX_SENS / sens;
+  light->gain  = again;
+  light->atime = 256 - steps;
+  light->valid = true;
+
+  if (sensor->als_autorange && (data[0] & APDS9960_STATUS_AVALID) &&
+      !mgos_apds9960_als_autorange(sensor, data[0], rgbc.clear, again, steps)) {
+    LOG(LL_WARN, ("Could not change APDS9960 light range at I2C 0x%02x", sensor->i2caddr));
+  }
+  return true;
+}
+
+bool mgos_apds9960_set_lux_coefficients(struct mgos_apds9960 *sensor, const struct mgos_apds9960_lux_coef *coef) {
+  if (!sensor) {
+    return false;
+  }
+  if (!coef) {
+    coef = &s_lux_coef_default;
+  }
+  if (coef->df == 0 || coef->ga == 0) {
+    return false;
+  }
+
+  sensor->lux_coef = *coef;
+  return true;
+}
+
+// DN40: the IR component is estimated from the excess of R+G+B over C and
+// removed from each channel. Lux is the weighted sum of the corrected channels
+// divided by counts-per-lux, ATIME[ms] x AGAIN / (GA x DF); CCT follows from
+// the corrected B/R ratio. All in integer arithmetic, coefficients in 1/1000.
+static void mgos_apds9960_lux_calc(const struct mgos_apds9960_lux_coef *coef, uint32_t c, uint32_t r, uint32_t g, uint32_t b,
+                                   uint32_t sens, uint32_t *mlux, uint16_t *cct) {
+  int32_t ir = ((int32_t)(r + g + b) - (int32_t)c) / 2;
+  int32_t r1, g1, b1;
+  int64_t g2;
+
+  if (ir < 0) {
+    ir = 0;
+  }
+  r1 = (int32_t)r - ir;
+  g1 = (int32_t)g - ir;
+  b1 = (int32_t)b - ir;
+  g2 = (int64_t)coef->r_coef * r1 + (int64_t)coef->g_coef * g1 + (int64_t)coef->b_coef * b1;
+
+  if (mlux) {
+    // sens is AGAIN x integration steps of 2780us
+    *mlux = g2 <= 0 ? 0 : (uint32_t)((uint64_t)g2 * coef->ga * coef->df / ((uint64_t)sens * 2780));
+  }
+  if (cct) {
+    // Strongly blue light can take the ratio far beyond 16 bits
+    uint64_t kelvin = r1 <= 0 || b1 < 0 ? 0 : (uint64_t)coef->ct_coef * b1 / r1 + coef->ct_offset;
+
+    *cct = kelvin > 0xFFFF ? 0xFFFF : (uint16_t)kelvin;
+  }
+}
+
+bool mgos_apds9960_light_to_lux(struct mgos_apds9960 *sensor, const struct mgos_apds9960_light *light, uint32_t *mlux, uint16_t *cct) {
+  if (!sensor || !light || !light->valid) {
+    return false;
+  }
+
+  mgos_apds9960_lux_calc(&sensor->lux_coef, light->clear, light->red, light->green, light->blue, ALS_MAX_SENS, mlux, cct);
+  return true;
+}
+
+bool mgos_apds9960_read_lux(struct mgos_apds9960 *sensor, uint32_t *mlux, uint16_t *cct) {
+  struct mgos_apds9960_rgbc rgbc;
+  uint8_t  again;
+  uint32_t steps;
+
+  if (!sensor) {
+    return false;
+  }
+
+  if (!mgos_apds9960_als_range(sensor, &again, &steps)) {
+    return false;
+  }
+  if (!mgos_apds9960_read_rgbc(sensor, &rgbc)) {
+    return false;
+  }
+  // A clipped clear channel throws off the IR estimate, down to zero lux
+  if (rgbc.clear >= mgos_apds9960_als_full_scale(steps)) {
+    return false;
+  }
+
+  mgos_apds9960_lux_calc(&sensor->lux_coef, rgbc.clear, rgbc.red, rgbc.green, rgbc.blue, s_again_mult[again] * steps, mlux, cct);
+  return true;
+}
@@ -22,7 +22,7 @@ bool mgos_apds9960_get_led_boost(struct mgos_apds9960 *sensor, uint8_t *boost) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONFIG2, boost)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG2, boost)) {
     return false;
   }
 
@@ -38,7 +38,7 @@ bool mgos_apds9960_set_led_boost(struct mgos_apds9960 *sensor, uint8_t boost) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONFIG2, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG2, &val)) {
     return false;
   }
 
@@ -54,6 +54,78 @@ bool mgos_apds9960_set_led_boost(struct mgos_apds9960 *sensor, uint8_t boost) {
   return true;
 }
 
+bool mgos_apds9960_get_light_saturation_int_enable(struct mgos_apds9960 *sensor, bool *enabled) {
+  uint8_t val;
+
+  if (!sensor || !enabled) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG2, &val)) {
+    return false;
+  }
+
+  *enabled = (val >> 6) & 0b00000001;
+  return true;
+}
+
+bool mgos_apds9960_set_light_saturation_int_enable(struct mgos_apds9960 *sensor, bool enable) {
+  uint8_t val;
+
+  if (!sensor) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG2, &val)) {
+    return false;
+  }
+
+  val &= 0b10111111;
+  val |= enable << 6;
+
+  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG2, val)) {
+    return false;
+  }
+
+  return true;
+}
+
+bool mgos_apds9960_get_proximity_saturation_int_enable(struct mgos_apds9960 *sensor, bool *enabled) {
+  uint8_t val;
+
+  if (!sensor || !enabled) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG2, &val)) {
+    return false;
+  }
+
+  *enabled = (val >> 7) & 0b00000001;
+  return true;
+}
+
+bool mgos_apds9960_set_proximity_saturation_int_enable(struct mgos_apds9960 *sensor, bool enable) {
+  uint8_t val;
+
+  if (!sensor) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG2, &val)) {
+    return false;
+  }
+
+  val &= 0b01111111;
+  val |= enable << 7;
+
+  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG2, val)) {
+    return false;
+  }
+
+  return true;
+}
+
 bool mgos_apds9960_get_proximity_gain_comp_enable(struct mgos_apds9960 *sensor, bool *enabled) {
   uint8_t val;
 
@@ -61,7 +133,7 @@ bool mgos_apds9960_get_proximity_gain_comp_enable(struct mgos_apds9960 *sensor,
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONFIG3, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG3, &val)) {
     return false;
   }
 
@@ -78,7 +150,7 @@ bool mgos_apds9960_set_proximity_gain_comp_enable(struct mgos_apds9960 *sensor,
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONFIG3, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG3, &val)) {
     return false;
   }
 
@@ -98,7 +170,7 @@ bool mgos_apds9960_get_proximity_photomask(struct mgos_apds9960 *sensor, uint8_t
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONFIG3, mask)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG3, mask)) {
     return false;
   }
 
@@ -113,7 +185,7 @@ bool mgos_apds9960_set_proximity_photomask(struct mgos_apds9960 *sensor, uint8_t
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONFIG3, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG3, &val)) {
     return false;
   }
 
@@ -128,12 +200,50 @@ bool mgos_apds9960_set_proximity_photomask(struct mgos_apds9960 *sensor, uint8_t
   return true;
 }
 
+bool mgos_apds9960_get_sleep_after_int(struct mgos_apds9960 *sensor, bool *enabled) {
+  uint8_t val;
+
+  if (!sensor || !enabled) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG3, &val)) {
+    return false;
+  }
+
+  *enabled = (val >> 4) & 0b00000001;
+  return true;
+}
+
+// With SAI set, the device stops all engines once it asserts an interrupt and
+// keeps the data registers latched; mgos_apds9960_clear_int() wakes it again.
+bool mgos_apds9960_set_sleep_after_int(struct mgos_apds9960 *sensor, bool enable) {
+  uint8_t val;
+
+  if (!sensor) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONFIG3, &val)) {
+    return false;
+  }
+
+  val &= 0b11101111;
+  val |= enable << 4;
+
+  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG3, val)) {
+    return false;
+  }
+
+  return true;
+}
+
 bool mgos_apds9960_get_gesture_enter_threshold(struct mgos_apds9960 *sensor, uint8_t *threshold) {
   if (!sensor || !threshold) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GPENTH, threshold)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GPENTH, threshold)) {
     return false;
   }
 
@@ -156,7 +266,7 @@ bool mgos_apds9960_get_gesture_exit_threshold(struct mgos_apds9960 *sensor, uint
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GEXTH, threshold)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GEXTH, threshold)) {
     return false;
   }
 
@@ -179,7 +289,7 @@ bool mgos_apds9960_get_gesture_wait_time(struct mgos_apds9960 *sensor, uint8_t *
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GCONF2, time)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GCONF2, time)) {
     return false;
   }
 
@@ -194,7 +304,7 @@ bool mgos_apds9960_set_gesture_wait_time(struct mgos_apds9960 *sensor, uint8_t t
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GCONF2, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GCONF2, &val)) {
     return false;
   }
 
@@ -209,6 +319,42 @@ bool mgos_apds9960_set_gesture_wait_time(struct mgos_apds9960 *sensor, uint8_t t
   return true;
 }
 
+bool mgos_apds9960_get_gesture_fifo_threshold(struct mgos_apds9960 *sensor, uint8_t *threshold) {
+  if (!sensor || !threshold) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GCONF1, threshold)) {
+    return false;
+  }
+
+  *threshold = (*threshold >> 6) & 0b00000011;
+  return true;
+}
+
+bool mgos_apds9960_set_gesture_fifo_threshold(struct mgos_apds9960 *sensor, uint8_t threshold) {
+  uint8_t val;
+
+  if (!sensor) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GCONF1, &val)) {
+    return false;
+  }
+
+  threshold &= 0b00000011;
+  threshold  = threshold << 6;
+  val       &= 0b00111111;
+  val       |= threshold;
+
+  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GCONF1, val)) {
+    return false;
+  }
+
+  return true;
+}
+
 bool mgos_apds9960_get_gesture_mode(struct mgos_apds9960 *sensor, uint8_t *mode) {
   if (!sensor || !mode) {
     return false;
@@ -244,109 +390,119 @@ bool mgos_apds9960_set_gesture_mode(struct mgos_apds9960 *sensor, uint8_t mode)
   return true;
 }
 
-bool mgos_apds9960_init(struct mgos_apds9960 *sensor) {
+// Power-on defaults, written as auto-increment bursts over the contiguous
+// register ranges. Reserved addresses inside a range are written as zero.
+static const uint8_t s_init_als_prox[] = {
+  APDS9960_DEFAULT_ATIME,                                  // 0x81 ATIME
+  0x00,                                                    // 0x82 reserved
+  APDS9960_DEFAULT_WTIME,                                  // 0x83 WTIME
+  APDS9960_DEFAULT_AILT & 0xFF,                            // 0x84 AILTL
+  (APDS9960_DEFAULT_AILT >> 8) & 0xFF,                     // 0x85 AILTH
+  APDS9960_DEFAULT_AIHT & 0xFF,                            // 0x86 AIHTL
+  (APDS9960_DEFAULT_AIHT >> 8) & 0xFF,                     // 0x87 AIHTH
+  0x00,                                                    // 0x88 reserved
+  APDS9960_DEFAULT_PILT,                                   // 0x89 PILT
+  0x00,                                                    // 0x8A reserved
+  APDS9960_DEFAULT_PIHT,                                   // 0x8B PIHT
+  APDS9960_DEFAULT_PERS,                                   // 0x8C PERS
+  APDS9960_DEFAULT_CONFIG1,                                // 0x8D CONFIG1
+  APDS9960_DEFAULT_PROX_PPULSE,                            // 0x8E PPULSE
+  (APDS9960_DEFAULT_LDRIVE << 6) | (APDS9960_DEFAULT_PGAIN << 2) | APDS9960_DEFAULT_AGAIN, // 0x8F CONTROL
+  APDS9960_DEFAULT_CONFIG2,                                // 0x90 CONFIG2
+};
+
+static const uint8_t s_init_offsets[] = {
+  APDS9960_DEFAULT_POFFSET_UR,                             // 0x9D POFFSET_UR
+  APDS9960_DEFAULT_POFFSET_DL,                             // 0x9E POFFSET_DL
+  APDS9960_DEFAULT_CONFIG3,                                // 0x9F CONFIG3
+};
+
+static const uint8_t s_init_gesture[] = {
+  APDS9960_DEFAULT_GPENTH,                                 // 0xA0 GPENTH
+  APDS9960_DEFAULT_GEXTH,                                  // 0xA1 GEXTH
+  APDS9960_DEFAULT_GCONF1,                                 // 0xA2 GCONF1
+  (APDS9960_DEFAULT_GGAIN << 5) | (APDS9960_DEFAULT_GLDRIVE << 3) | APDS9960_DEFAULT_GWTIME, // 0xA3 GCONF2
+  APDS9960_DEFAULT_GOFFSET,                                // 0xA4 GOFFSET_U
+  APDS9960_DEFAULT_GOFFSET,                                // 0xA5 GOFFSET_D
+  APDS9960_DEFAULT_GPULSE,                                 // 0xA6 GPULSE
+  APDS9960_DEFAULT_GOFFSET,                                // 0xA7 GOFFSET_L
+  0x00,                                                    // 0xA8 reserved
+  APDS9960_DEFAULT_GOFFSET,                                // 0xA9 GOFFSET_R
+  APDS9960_DEFAULT_GCONF3,                                 // 0xAA GCONF3
+  APDS9960_DEFAULT_GIEN << 1,                              // 0xAB GCONF4
+};
+
+static const struct {
+  uint8_t        reg;
+  uint8_t        len;
+  const uint8_t *val;
+} s_init_table[] = {
+  { APDS9960_ATIME,      sizeof(s_init_als_prox), s_init_als_prox },
+  { APDS9960_POFFSET_UR, sizeof(s_init_offsets),  s_init_offsets  },
+  { APDS9960_GPENTH,     sizeof(s_init_gesture),  s_init_gesture  },
+};
+
+static bool mgos_apds9960_init_regs(struct mgos_apds9960 *sensor, bool reset) {
+  uint8_t val = 0x00;
+
   if (!sensor) {
     return false;
   }
 
-  // Reset device first: power down and disable all features
-  if (!mgos_apds9960_disable(sensor)) {
-    return false;
+  if (reset) {
+    // Reset device first: power down and disable all features
+    if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ENABLE, val)) {
+      return false;
+    }
+  } else {
+    // ENABLE is 0x00 after power-on-reset, seed the shadow copy with that.
+    mgos_apds9960_shadow_store(sensor, APDS9960_ENABLE, &val, 1);
   }
 
-  // Set default values for ambient light and proximity registers
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ATIME, APDS9960_DEFAULT_ATIME)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_WTIME, APDS9960_DEFAULT_WTIME)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_PPULSE, APDS9960_DEFAULT_PROX_PPULSE)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_POFFSET_UR, APDS9960_DEFAULT_POFFSET_UR)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_POFFSET_DL, APDS9960_DEFAULT_POFFSET_DL)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG1, APDS9960_DEFAULT_CONFIG1)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_led_drive(sensor, APDS9960_DEFAULT_LDRIVE)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_proximity_gain(sensor, APDS9960_DEFAULT_PGAIN)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_light_gain(sensor, APDS9960_DEFAULT_AGAIN)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_proximity_int_low_threshold(sensor, APDS9960_DEFAULT_PILT)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_proximity_int_high_threshold(sensor, APDS9960_DEFAULT_PIHT)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_light_int_low_threshold(sensor, APDS9960_DEFAULT_AILT)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_light_int_high_threshold(sensor, APDS9960_DEFAULT_AIHT)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_PERS, APDS9960_DEFAULT_PERS)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG2, APDS9960_DEFAULT_CONFIG2)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG3, APDS9960_DEFAULT_CONFIG3)) {
-    return false;
+  for (size_t i = 0; i < sizeof(s_init_table) / sizeof(s_init_table[0]); i++) {
+    if (!mgos_apds9960_wireWriteDataBlock(sensor, s_init_table[i].reg, s_init_table[i].val, s_init_table[i].len)) {
+      return false;
+    }
   }
 
-  // Set default values for gesture sense registers
-  if (!mgos_apds9960_set_gesture_enter_threshold(sensor, APDS9960_DEFAULT_GPENTH)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_gesture_exit_threshold(sensor, APDS9960_DEFAULT_GEXTH)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GCONF1, APDS9960_DEFAULT_GCONF1)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_gesture_gain(sensor, APDS9960_DEFAULT_GGAIN)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_gesture_led_drive(sensor, APDS9960_DEFAULT_GLDRIVE)) {
-    return false;
-  }
-  if (!mgos_apds9960_set_gesture_wait_time(sensor, APDS9960_DEFAULT_GWTIME)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GOFFSET_U, APDS9960_DEFAULT_GOFFSET)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GOFFSET_D, APDS9960_DEFAULT_GOFFSET)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GOFFSET_L, APDS9960_DEFAULT_GOFFSET)) {
-    return false;
-  }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GOFFSET_R, APDS9960_DEFAULT_GOFFSET)) {
+  // Turn on the sensor power
+  return mgos_apds9960_enable(sensor);
+}
+
+bool mgos_apds9960_init(struct mgos_apds9960 *sensor) {
+  return mgos_apds9960_init_regs(sensor, true);
+}
+
+bool mgos_apds9960_init_after_por(struct mgos_apds9960 *sensor) {
+  return mgos_apds9960_init_regs(sensor, false);
+}
+
+// Re-reads all shadowed configuration registers from the device, e.g. after
+// a brown-out reset. Two bursts are used to skip over the STATUS and data
+// registers, reading which would clear AVALID/PVALID as a side effect.
+// A device whose CONFIG1 lost the bit set by the driver's own init has been
+// through a power-on-reset, and is initialized again. ENABLE alone cannot
+// tell, as the application may have powered the device down itself.
+bool mgos_apds9960_resync(struct mgos_apds9960 *sensor) {
+  uint8_t buf[APDS9960_CONFIG2 - APDS9960_ENABLE + 1];
+
+  if (!sensor) {
     return false;
   }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GPULSE, APDS9960_DEFAULT_GPULSE)) {
+
+  mgos_apds9960_shadow_invalidate(sensor);
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_ENABLE, buf, APDS9960_CONFIG2 - APDS9960_ENABLE + 1) < 0) {
     return false;
   }
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GCONF3, APDS9960_DEFAULT_GCONF3)) {
-    return false;
+  if (!(buf[APDS9960_CONFIG1 - APDS9960_ENABLE] & APDS9960_CONFIG1_INIT)) {
+    LOG(LL_WARN, ("APDS9960 at I2C 0x%02x was reset, initializing it again", sensor->i2caddr));
+    return mgos_apds9960_init_after_por(sensor);
   }
-  if (!mgos_apds9960_set_gesture_int_enable(sensor, APDS9960_DEFAULT_GIEN)) {
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_POFFSET_UR, buf, APDS9960_GCONF3 - APDS9960_POFFSET_UR + 1) < 0) {
     return false;
   }
 
-  // Turn on the sensor power
-  return mgos_apds9960_enable(sensor);
+  return true;
 }
 
 bool mgos_apds9960_enable(struct mgos_apds9960 *sensor) {
@@ -374,7 +530,7 @@ bool mgos_apds9960_get_mode(struct mgos_apds9960 *sensor, uint8_t *mode) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_ENABLE, mode)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, mode)) {
     return false;
   }
 
@@ -542,7 +698,7 @@ bool mgos_apds9960_get_led_drive(struct mgos_apds9960 *sensor, uint8_t *drive) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONTROL, drive)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONTROL, drive)) {
     return false;
   }
 
@@ -557,7 +713,7 @@ bool mgos_apds9960_set_led_drive(struct mgos_apds9960 *sensor, uint8_t drive) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONTROL, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONTROL, &val)) {
     return false;
   }
 
@@ -580,7 +736,7 @@ bool mgos_apds9960_get_gesture_led_drive(struct mgos_apds9960 *sensor, bool *ena
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GCONF2, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GCONF2, &val)) {
     return false;
   }
 
@@ -596,7 +752,7 @@ bool mgos_apds9960_set_gesture_led_drive(struct mgos_apds9960 *sensor, bool enab
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GCONF2, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GCONF2, &val)) {
     return false;
   }
 
@@ -616,7 +772,7 @@ bool mgos_apds9960_get_light_gain(struct mgos_apds9960 *sensor, uint8_t *gain) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONTROL, gain)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONTROL, gain)) {
     return false;
   }
 
@@ -631,7 +787,7 @@ bool mgos_apds9960_set_light_gain(struct mgos_apds9960 *sensor, uint8_t gain) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONTROL, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONTROL, &val)) {
     return false;
   }
 
@@ -646,12 +802,28 @@ bool mgos_apds9960_set_light_gain(struct mgos_apds9960 *sensor, uint8_t gain) {
   return true;
 }
 
+bool mgos_apds9960_get_light_integration_time(struct mgos_apds9960 *sensor, uint8_t *atime) {
+  if (!sensor || !atime) {
+    return false;
+  }
+
+  return mgos_apds9960_reg_read(sensor, APDS9960_ATIME, atime);
+}
+
+bool mgos_apds9960_set_light_integration_time(struct mgos_apds9960 *sensor, uint8_t atime) {
+  if (!sensor) {
+    return false;
+  }
+
+  return mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ATIME, atime);
+}
+
 bool mgos_apds9960_get_proximity_gain(struct mgos_apds9960 *sensor, uint8_t *gain) {
   if (!sensor || !gain) {
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONTROL, gain)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONTROL, gain)) {
     return false;
   }
 
@@ -666,7 +838,7 @@ bool mgos_apds9960_set_proximity_gain(struct mgos_apds9960 *sensor, uint8_t gain
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CONTROL, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_CONTROL, &val)) {
     return false;
   }
 
@@ -687,7 +859,7 @@ bool mgos_apds9960_get_gesture_gain(struct mgos_apds9960 *sensor, uint8_t *gain)
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GCONF2, gain)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GCONF2, gain)) {
     return false;
   }
 
@@ -702,7 +874,7 @@ bool mgos_apds9960_set_gesture_gain(struct mgos_apds9960 *sensor, uint8_t gain)
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GCONF2, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_GCONF2, &val)) {
     return false;
   }
 
@@ -725,12 +897,12 @@ bool mgos_apds9960_get_light_int_low_threshold(struct mgos_apds9960 *sensor, uin
   }
   *threshold = 0;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_AILTL, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_AILTL, &val)) {
     return false;
   }
   *threshold = val;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_AILTH, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_AILTH, &val)) {
     return false;
   }
   *threshold += ((uint16_t)val << 8);
@@ -739,26 +911,17 @@ bool mgos_apds9960_get_light_int_low_threshold(struct mgos_apds9960 *sensor, uin
 }
 
 bool mgos_apds9960_set_light_int_low_threshold(struct mgos_apds9960 *sensor, uint16_t threshold) {
-  uint8_t val_low;
-  uint8_t val_high;
+  struct mgos_apds9960_txn txn;
 
   if (!sensor) {
     return false;
   }
 
   // Break 16-bit threshold into 2 8-bit values
-  val_low  = threshold & 0x00FF;
-  val_high = (threshold & 0xFF00) >> 8;
-
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_AILTL, val_low)) {
-    return false;
-  }
-
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_AILTH, val_high)) {
-    return false;
-  }
-
-  return true;
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_write(&txn, APDS9960_AILTL, threshold & 0x00FF);
+  mgos_apds9960_txn_write(&txn, APDS9960_AILTH, (threshold & 0xFF00) >> 8);
+  return mgos_apds9960_txn_commit(&txn);
 }
 
 bool mgos_apds9960_get_light_int_high_threshold(struct mgos_apds9960 *sensor, uint16_t *threshold) {
@@ -770,12 +933,12 @@ bool mgos_apds9960_get_light_int_high_threshold(struct mgos_apds9960 *sensor, ui
 
   *threshold = 0;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_AIHTL, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_AIHTL, &val)) {
     return false;
   }
   *threshold = val;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_AIHTH, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_AIHTH, &val)) {
     return false;
   }
   *threshold += ((uint16_t)val << 8);
@@ -784,26 +947,33 @@ bool mgos_apds9960_get_light_int_high_threshold(struct mgos_apds9960 *sensor, ui
 }
 
 bool mgos_apds9960_set_light_int_high_threshold(struct mgos_apds9960 *sensor, uint16_t threshold) {
-  uint8_t val_low;
-  uint8_t val_high;
+  struct mgos_apds9960_txn txn;
 
   if (!sensor) {
     return false;
   }
 
   // Break 16-bit threshold into 2 8-bit values
-  val_low  = threshold & 0x00FF;
-  val_high = (threshold & 0xFF00) >> 8;
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_write(&txn, APDS9960_AIHTL, threshold & 0x00FF);
+  mgos_apds9960_txn_write(&txn, APDS9960_AIHTH, (threshold & 0xFF00) >> 8);
+  return mgos_apds9960_txn_commit(&txn);
+}
 
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_AIHTL, val_low)) {
-    return false;
-  }
+// AILTL through AIHTH in one burst
+bool mgos_apds9960_set_light_int_thresholds(struct mgos_apds9960 *sensor, uint16_t low, uint16_t high) {
+  struct mgos_apds9960_txn txn;
 
-  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_AIHTH, val_high)) {
+  if (!sensor) {
     return false;
   }
 
-  return true;
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_write(&txn, APDS9960_AILTL, low & 0xFF);
+  mgos_apds9960_txn_write(&txn, APDS9960_AILTH, low >> 8);
+  mgos_apds9960_txn_write(&txn, APDS9960_AIHTL, high & 0xFF);
+  mgos_apds9960_txn_write(&txn, APDS9960_AIHTH, high >> 8);
+  return mgos_apds9960_txn_commit(&txn);
 }
 
 bool mgos_apds9960_get_proximity_int_low_threshold(struct mgos_apds9960 *sensor, uint8_t *threshold) {
@@ -811,7 +981,7 @@ bool mgos_apds9960_get_proximity_int_low_threshold(struct mgos_apds9960 *sensor,
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_PILT, threshold)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_PILT, threshold)) {
     return false;
   }
 
@@ -835,7 +1005,7 @@ bool mgos_apds9960_get_proximity_int_high_threshold(struct mgos_apds9960 *sensor
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_PIHT, threshold)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_PIHT, threshold)) {
     return false;
   }
 
@@ -854,6 +1024,55 @@ bool mgos_apds9960_set_proximity_int_high_threshold(struct mgos_apds9960 *sensor
   return true;
 }
 
+// PILT and PIHT in one burst, bridged over the reserved register between them
+bool mgos_apds9960_set_proximity_int_thresholds(struct mgos_apds9960 *sensor, uint8_t low, uint8_t high) {
+  struct mgos_apds9960_txn txn;
+
+  if (!sensor) {
+    return false;
+  }
+
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_write(&txn, APDS9960_PILT, low);
+  mgos_apds9960_txn_write(&txn, APDS9960_PIHT, high);
+  return mgos_apds9960_txn_commit(&txn);
+}
+
+bool mgos_apds9960_get_proximity_int_persistence(struct mgos_apds9960 *sensor, uint8_t *persistence) {
+  if (!sensor || !persistence) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_PERS, persistence)) {
+    return false;
+  }
+
+  *persistence = (*persistence >> 4) & 0b00001111;
+  return true;
+}
+
+bool mgos_apds9960_set_proximity_int_persistence(struct mgos_apds9960 *sensor, uint8_t persistence) {
+  uint8_t val;
+
+  if (!sensor) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_PERS, &val)) {
+    return false;
+  }
+
+  persistence &= 0b00001111;
+  val         &= 0b00001111;
+  val         |= persistence << 4;
+
+  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_PERS, val)) {
+    return false;
+  }
+
+  return true;
+}
+
 bool mgos_apds9960_get_light_int_enable(struct mgos_apds9960 *sensor, bool *enabled) {
   uint8_t val;
 
@@ -861,7 +1080,7 @@ bool mgos_apds9960_get_light_int_enable(struct mgos_apds9960 *sensor, bool *enab
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_ENABLE, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &val)) {
     return false;
   }
 
@@ -876,7 +1095,7 @@ bool mgos_apds9960_set_light_int_enable(struct mgos_apds9960 *sensor, bool enabl
   if (!sensor) {
     return false;
   }
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_ENABLE, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &val)) {
     return false;
   }
 
@@ -898,7 +1117,7 @@ bool mgos_apds9960_get_proximity_int_enable(struct mgos_apds9960 *sensor, bool *
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_ENABLE, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &val)) {
     return false;
   }
 
@@ -913,7 +1132,7 @@ bool mgos_apds9960_set_proximity_int_enable(struct mgos_apds9960 *sensor, bool e
   if (!sensor) {
     return false;
   }
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_ENABLE, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &val)) {
     return false;
   }
 
@@ -950,7 +1169,7 @@ bool mgos_apds9960_get_gesture_int_enable(struct mgos_apds9960 *sensor, bool *en
     return false;
   }
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_ENABLE, &val)) {
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &val)) {
     return false;
   }
 
@@ -996,17 +1215,22 @@ bool mgos_apds9960_get_light_int(struct mgos_apds9960 *sensor, bool *firing) {
   return true;
 }
 
+// Addressing AICLEAR is enough to clear all non-gesture interrupts, so this
+// is a single one byte write. It also ends sleep-after-interrupt.
 bool mgos_apds9960_clear_int(struct mgos_apds9960 *sensor) {
-  uint8_t val;
-
   if (!sensor) {
     return false;
   }
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_AICLEAR, &val)) {
+
+  return mgos_apds9960_wireWriteByte(sensor, APDS9960_AICLEAR);
+}
+
+bool mgos_apds9960_get_status(struct mgos_apds9960 *sensor, uint8_t *status) {
+  if (!sensor || !status) {
     return false;
   }
 
-  return true;
+  return mgos_apds9960_wireReadDataByte(sensor, APDS9960_STATUS, status);
 }
 
 bool mgos_apds9960_get_proximity_int(struct mgos_apds9960 *sensor, bool *firing) {
@@ -1025,90 +1249,144 @@ bool mgos_apds9960_get_proximity_int(struct mgos_apds9960 *sensor, bool *firing)
 }
 
 bool mgos_apds9960_read_ambient_light(struct mgos_apds9960 *sensor, uint16_t *val) {
-  uint8_t val_byte;
+  struct mgos_apds9960_txn txn;
+  uint8_t val_bytes[2];
 
   if (!sensor || !val) {
     return false;
   }
   *val = 0;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CDATAL, &val_byte)) {
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_read(&txn, APDS9960_CDATAL, &val_bytes[0]);
+  mgos_apds9960_txn_read(&txn, APDS9960_CDATAH, &val_bytes[1]);
+  if (!mgos_apds9960_txn_commit(&txn)) {
     return false;
   }
-  *val = val_byte;
-
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_CDATAH, &val_byte)) {
-    return false;
-  }
-  *val += ((uint16_t)val_byte << 8);
+  *val = val_bytes[0] + ((uint16_t)val_bytes[1] << 8);
 
   return true;
 }
 
 bool mgos_apds9960_read_red_light(struct mgos_apds9960 *sensor, uint16_t *val) {
-  uint8_t val_byte;
+  struct mgos_apds9960_txn txn;
+  uint8_t val_bytes[2];
 
   if (!sensor || !val) {
     return false;
   }
   *val = 0;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_RDATAL, &val_byte)) {
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_read(&txn, APDS9960_RDATAL, &val_bytes[0]);
+  mgos_apds9960_txn_read(&txn, APDS9960_RDATAH, &val_bytes[1]);
+  if (!mgos_apds9960_txn_commit(&txn)) {
     return false;
   }
-  *val = val_byte;
-
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_RDATAH, &val_byte)) {
-    return false;
-  }
-  *val += ((uint16_t)val_byte << 8);
+  *val = val_bytes[0] + ((uint16_t)val_bytes[1] << 8);
 
   return true;
 }
 
 bool mgos_apds9960_read_green_light(struct mgos_apds9960 *sensor, uint16_t *val) {
-  uint8_t val_byte;
+  struct mgos_apds9960_txn txn;
+  uint8_t val_bytes[2];
 
   if (!sensor || !val) {
     return false;
   }
   *val = 0;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GDATAL, &val_byte)) {
-    return false;
-  }
-  *val = val_byte;
-
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GDATAH, &val_byte)) {
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_read(&txn, APDS9960_GDATAL, &val_bytes[0]);
+  mgos_apds9960_txn_read(&txn, APDS9960_GDATAH, &val_bytes[1]);
+  if (!mgos_apds9960_txn_commit(&txn)) {
     return false;
   }
-  *val += ((uint16_t)val_byte << 8);
+  *val = val_bytes[0] + ((uint16_t)val_bytes[1] << 8);
 
   return true;
 }
 
 bool mgos_apds9960_read_blue_light(struct mgos_apds9960 *sensor, uint16_t *val) {
-  uint8_t val_byte;
+  struct mgos_apds9960_txn txn;
+  uint8_t val_bytes[2];
 
   if (!sensor || !val) {
     return false;
   }
   *val = 0;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_BDATAL, &val_byte)) {
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_read(&txn, APDS9960_BDATAL, &val_bytes[0]);
+  mgos_apds9960_txn_read(&txn, APDS9960_BDATAH, &val_bytes[1]);
+  if (!mgos_apds9960_txn_commit(&txn)) {
+    return false;
+  }
+  *val = val_bytes[0] + ((uint16_t)val_bytes[1] << 8);
+
+  return true;
+}
+
+/* End sparkfun import */
+
+// Reads CDATAL..BDATAH (0x94-0x9B) in one auto-increment burst. Reading the
+// low byte first latches the high byte, so all four channels are guaranteed
+// to come from the same integration cycle.
+bool mgos_apds9960_read_rgbc(struct mgos_apds9960 *sensor, struct mgos_apds9960_rgbc *rgbc) {
+  uint8_t data[8];
+
+  if (!sensor || !rgbc) {
     return false;
   }
-  *val = val_byte;
 
-  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_BDATAH, &val_byte)) {
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_CDATAL, data, sizeof(data)) != sizeof(data)) {
     return false;
   }
-  *val += ((uint16_t)val_byte << 8);
 
+  mgos_apds9960_decode_rgbc(data, rgbc);
   return true;
 }
 
-/* End sparkfun import */
+// Time spent in one proximity or gesture conversion for a PPULSE/GPULSE
+// value: about 800us plus the accumulation time of the IR pulses.
+uint32_t mgos_apds9960_pulse_time_us(uint8_t pulse) {
+  static const uint32_t pulse_ns[] = { 28600, 36700, 53100, 85700 };
+
+  return 797 + ((pulse & 0x3F) + 1) * pulse_ns[pulse >> 6] / 1000;
+}
+
+// Length of one pass through the proximity, wait and ALS states, in usec.
+// ALS integration and wait time are both in steps of 2.78ms (x12 for WLONG).
+bool mgos_apds9960_get_cycle_time(struct mgos_apds9960 *sensor, uint32_t *usecs) {
+  uint8_t  enable, atime, wtime, config1, ppulse;
+  uint32_t cycle = 0;
+
+  if (!sensor || !usecs) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &enable) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_ATIME, &atime) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_WTIME, &wtime) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_CONFIG1, &config1) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_PPULSE, &ppulse)) {
+    return false;
+  }
+
+  if (enable & APDS9960_PEN) {
+    cycle += mgos_apds9960_pulse_time_us(ppulse);
+  }
+  if (enable & APDS9960_WEN) {
+    cycle += (256 - wtime) * 2780 * ((config1 & APDS9960_WLONG) ? 12 : 1);
+  }
+  if (enable & APDS9960_AEN) {
+    cycle += (256 - atime) * 2780;
+  }
+
+  *usecs = cycle;
+  return true;
+}
 
 // Fifo size is 32 tuples of 4 bytes -- so *fifo must be at least 128 bytes!
 bool mgos_apds9960_get_gesture_fifo(struct mgos_apds9960 *sensor, uint8_t *fifo, uint8_t *bytes_read) {
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+struct mgos_apds9960_async_op {
+  struct mgos_apds9960 *     sensor;
+  bool                       write;
+  uint8_t                    reg;
+  uint8_t                    len;
+  uint8_t                    data[APDS9960_ASYNC_MAX_LEN];
+  mgos_apds9960_async_done_t done;
+  void *                     done_arg;
+};
+
+// One queue for all sensors, in submission order: they may share a bus
+static struct mgos_apds9960_async_op s_ops[APDS9960_ASYNC_QUEUE_SIZE];
+static uint8_t s_num_ops   = 0;
+static bool    s_scheduled = false;
+
+static void mgos_apds9960_async_worker(void *arg);
+
+static void mgos_apds9960_async_schedule(void) {
+  if (s_scheduled || s_num_ops == 0) {
+    return;
+  }
+  s_scheduled = true;
+  if (!mgos_invoke_cb(mgos_apds9960_async_worker, NULL, false)) {
+    LOG(LL_ERROR, ("Could not schedule APDS9960 bus queue"));
+    s_scheduled = false;
+  }
+}
+
+// Whether a read may run on through the registers between two ops
+static bool mgos_apds9960_async_bridge(struct mgos_apds9960 *sensor, int from, int to) {
+  uint8_t val;
+
+  if (to - from > APDS9960_TXN_MAX_GAP) {
+    return false;
+  }
+  for (int reg = from; reg < to; reg++) {
+    if (!mgos_apds9960_txn_bridge(sensor, reg, false, &val)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Takes the op at the head of the queue, along with the ops directly behind
+// it which go on up the register range in the same direction on the same
+// sensor, as long as the range spanned fits one transfer. Reads only skip
+// registers which can be read without side effects, and a gesture FIFO burst
+// is never merged.
+static uint8_t mgos_apds9960_async_take(struct mgos_apds9960_async_op *batch) {
+  uint8_t n   = 1;
+  int     end = s_ops[0].reg + s_ops[0].len;
+
+  while (n < s_num_ops && n < APDS9960_ASYNC_COALESCE) {
+    const struct mgos_apds9960_async_op *op = &s_ops[n];
+
+    if (op->sensor != s_ops[0].sensor || op->write != s_ops[0].write ||
+        op->reg < end || op->reg + op->len - s_ops[0].reg > APDS9960_ASYNC_MAX_LEN || op->reg + op->len > 0x100) {
+      break;
+    }
+    if (!op->write && !mgos_apds9960_async_bridge(op->sensor, end, op->reg)) {
+      break;
+    }
+    end = op->reg + op->len;
+    n++;
+  }
+
+  memcpy(batch, s_ops, n * sizeof(s_ops[0]));
+  memmove(s_ops, &s_ops[n], (s_num_ops - n) * sizeof(s_ops[0]));
+  s_num_ops -= n;
+  return n;
+}
+
+// One transfer for the whole batch, then completions in order. Writes go
+// through a transaction, which fills the gaps. Reads are one plain block read
+// over the span as submitted: a burst from GFIFO_U has to reach the device as
+// such, so that it keeps popping datasets.
+static void mgos_apds9960_async_run(struct mgos_apds9960_async_op *batch, uint8_t n) {
+  struct mgos_apds9960_txn txn;
+  uint8_t      buf[APDS9960_ASYNC_MAX_LEN];
+  unsigned int len;
+  bool         ok;
+
+  if (batch[0].write) {
+    mgos_apds9960_txn_init(&txn, batch[0].sensor);
+    for (uint8_t i = 0; i < n; i++) {
+      mgos_apds9960_txn_write_block(&txn, batch[i].reg, batch[i].data, batch[i].len);
+    }
+    ok = mgos_apds9960_txn_commit(&txn);
+  } else {
+    len = batch[n - 1].reg + batch[n - 1].len - batch[0].reg;
+    ok  = mgos_apds9960_wireReadDataBlock(batch[0].sensor, batch[0].reg, buf, len) == (int)len;
+    for (uint8_t i = 0; i < n && ok; i++) {
+      memcpy(batch[i].data, &buf[batch[i].reg - batch[0].reg], batch[i].len);
+    }
+  }
+
+  for (uint8_t i = 0; i < n; i++) {
+    if (batch[i].done) {
+      batch[i].done(batch[i].sensor, batch[i].reg, batch[i].data, batch[i].len, ok, batch[i].done_arg);
+    }
+  }
+}
+
+// Runs a few transfers per invocation and then yields, so that other tasks
+// and bus users get their turn while the queue is long.
+static void mgos_apds9960_async_worker(void *arg) {
+  struct mgos_apds9960_async_op batch[APDS9960_ASYNC_COALESCE];
+
+  s_scheduled = false;
+  for (int i = 0; i < APDS9960_ASYNC_BATCH && s_num_ops > 0; i++) {
+    uint8_t n = mgos_apds9960_async_take(batch);
+
+    mgos_apds9960_async_run(batch, n);
+  }
+  mgos_apds9960_async_schedule();
+  (void)arg;
+}
+
+static bool mgos_apds9960_async_submit(struct mgos_apds9960 *sensor, bool write, uint8_t reg, const uint8_t *data, uint8_t len,
+                                       mgos_apds9960_async_done_t done, void *arg) {
+  struct mgos_apds9960_async_op *op;
+
+  if (!sensor || len == 0 || len > APDS9960_ASYNC_MAX_LEN) {
+    return false;
+  }
+  // Only a read from the gesture FIFO may go past 0xFF, the device wraps it
+  // back to GFIFO_U
+  if (reg + len > 0x100 && (write || reg < APDS9960_GFIFO_U)) {
+    return false;
+  }
+  if (s_num_ops >= APDS9960_ASYNC_QUEUE_SIZE) {
+    LOG(LL_WARN, ("APDS9960 bus queue full"));
+    return false;
+  }
+
+  op           = &s_ops[s_num_ops++];
+  op->sensor   = sensor;
+  op->write    = write;
+  op->reg      = reg;
+  op->len      = len;
+  op->done     = done;
+  op->done_arg = arg;
+  if (write) {
+    memcpy(op->data, data, len);
+  }
+  mgos_apds9960_async_schedule();
+  return true;
+}
+
+bool mgos_apds9960_async_read(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t len, mgos_apds9960_async_done_t done, void *arg) {
+  return mgos_apds9960_async_submit(sensor, false, reg, NULL, len, done, arg);
+}
+
+bool mgos_apds9960_async_write(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *data, uint8_t len, mgos_apds9960_async_done_t done, void *arg) {
+  if (!data) {
+    return false;
+  }
+  return mgos_apds9960_async_submit(sensor, true, reg, data, len, done, arg);
+}
+
+void mgos_apds9960_async_flush(void) {
+  struct mgos_apds9960_async_op batch[APDS9960_ASYNC_COALESCE];
+
+  while (s_num_ops > 0) {
+    uint8_t n = mgos_apds9960_async_take(batch);
+
+    mgos_apds9960_async_run(batch, n);
+  }
+}
+
+// Drops the ops of a sensor which is going away, without completing them
+void mgos_apds9960_async_cancel(struct mgos_apds9960 *sensor) {
+  uint8_t n = 0;
+
+  for (uint8_t i = 0; i < s_num_ops; i++) {
+    if (s_ops[i].sensor != sensor) {
+      s_ops[n++] = s_ops[i];
+    }
+  }
+  s_num_ops = n;
+}
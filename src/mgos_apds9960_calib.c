@@ -0,0 +1,289 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+#define CALIB_PMASK_UR    0b00000110  // PMASK_D | PMASK_L: only the U/R pair active
+#define CALIB_PMASK_DL    0b00001001  // PMASK_U | PMASK_R: only the D/L pair active
+
+// Offset registers are sign/magnitude: bit 7 set makes the value negative.
+// Positive offsets subtract from the result, so counts fall as offset rises.
+static uint8_t mgos_apds9960_offset_encode(int offset) {
+  return offset < 0 ? 0x80 | (uint8_t)(-offset) : (uint8_t)offset;
+}
+
+static bool mgos_apds9960_calib_measure_proximity(struct mgos_apds9960 *sensor, uint8_t reg, int offset, uint16_t *pdata) {
+  struct mgos_apds9960_sample sample;
+  uint16_t sum = 0;
+
+  if (!mgos_apds9960_wireWriteDataByte(sensor, reg, mgos_apds9960_offset_encode(offset))) {
+    return false;
+  }
+
+  // The first conversion may have started before the offset was written
+  for (int i = 0; i <= APDS9960_CALIB_SAMPLES; i++) {
+    if (!mgos_apds9960_wait_for_sample(sensor, APDS9960_STATUS_PVALID, &sample)) {
+      return false;
+    }
+    if (i > 0) {
+      sum += sample.proximity;
+    }
+  }
+  *pdata = sum / APDS9960_CALIB_SAMPLES;
+  return true;
+}
+
+// Smallest offset in -127..127 that brings the masked pair down to the target
+static bool mgos_apds9960_calib_proximity_pair(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t mask, uint8_t *result) {
+  int      lo = -127, hi = 127;
+  uint16_t pdata;
+
+  if (!mgos_apds9960_set_proximity_photomask(sensor, mask)) {
+    return false;
+  }
+
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+
+    if (!mgos_apds9960_calib_measure_proximity(sensor, reg, mid, &pdata)) {
+      return false;
+    }
+    if (pdata <= APDS9960_CALIB_TARGET) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+
+  *result = mgos_apds9960_offset_encode(lo);
+  return mgos_apds9960_wireWriteDataByte(sensor, reg, *result);
+}
+
+// GOFFSET_U/D and GOFFSET_L/R, merged into one burst over GPULSE and the
+// reserved register when the former is known
+static bool mgos_apds9960_calib_write_goffsets(struct mgos_apds9960 *sensor, const int *offset) {
+  struct mgos_apds9960_txn txn;
+
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_write(&txn, APDS9960_GOFFSET_U, mgos_apds9960_offset_encode(offset[0]));
+  mgos_apds9960_txn_write(&txn, APDS9960_GOFFSET_D, mgos_apds9960_offset_encode(offset[1]));
+  mgos_apds9960_txn_write(&txn, APDS9960_GOFFSET_L, mgos_apds9960_offset_encode(offset[2]));
+  mgos_apds9960_txn_write(&txn, APDS9960_GOFFSET_R, mgos_apds9960_offset_encode(offset[3]));
+  return mgos_apds9960_txn_commit(&txn);
+}
+
+// Flushes the FIFO and averages the datasets collected with the new offsets,
+// dropping the first which may predate them.
+static bool mgos_apds9960_calib_measure_gesture(struct mgos_apds9960 *sensor, uint8_t gconf4, const int *offset, uint16_t *avg) {
+  uint8_t  fifo[(APDS9960_CALIB_SAMPLES + 1) * 4];
+  uint8_t  level = 0;
+  int64_t  deadline;
+
+  if (!mgos_apds9960_calib_write_goffsets(sensor, offset)) {
+    return false;
+  }
+  if (!mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GCONF4, gconf4 | APDS9960_GFIFO_CLR)) {
+    return false;
+  }
+
+  deadline = mgos_uptime_micros() + APDS9960_CALIB_TIMEOUT_MS * 1000;
+  while (level < APDS9960_CALIB_SAMPLES + 1) {
+    if (mgos_uptime_micros() > deadline) {
+      LOG(LL_ERROR, ("Timeout waiting for APDS9960 gesture data"));
+      return false;
+    }
+    mgos_usleep(APDS9960_CALIB_POLL_US);
+    if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GFLVL, &level)) {
+      return false;
+    }
+  }
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_GFIFO_U, fifo, sizeof(fifo)) != sizeof(fifo)) {
+    return false;
+  }
+
+  for (int ch = 0; ch < 4; ch++) {
+    uint16_t sum = 0;
+
+    for (int i = 1; i <= APDS9960_CALIB_SAMPLES; i++) {
+      sum += fifo[i * 4 + ch];
+    }
+    avg[ch] = sum / APDS9960_CALIB_SAMPLES;
+  }
+  return true;
+}
+
+// The four channels are independent, so their binary searches run in step
+static bool mgos_apds9960_calib_gesture(struct mgos_apds9960 *sensor, struct mgos_apds9960_calibration *cal) {
+  int      lo[4] = { -127, -127, -127, -127 }, hi[4] = { 127, 127, 127, 127 };
+  int      mid[4];
+  uint16_t avg[4];
+  uint8_t  gconf4;
+  bool     done = false;
+
+  // Force the gesture engine on, without interrupts. GEXTH 0 keeps it from
+  // exiting once the offsets bring all channels down.
+  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GCONF4, &gconf4) ||
+      !mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GEXTH, 0)) {
+    return false;
+  }
+  gconf4 = (gconf4 & ~APDS9960_GIEN_BIT) | APDS9960_GMODE;
+
+  while (!done) {
+    done = true;
+    for (int ch = 0; ch < 4; ch++) {
+      mid[ch] = lo[ch] + (hi[ch] - lo[ch]) / 2;
+      if (lo[ch] < hi[ch]) {
+        done = false;
+      }
+    }
+    if (done) {
+      break;
+    }
+    if (!mgos_apds9960_calib_measure_gesture(sensor, gconf4, mid, avg)) {
+      return false;
+    }
+    for (int ch = 0; ch < 4; ch++) {
+      if (lo[ch] >= hi[ch]) {
+        continue;
+      }
+      if (avg[ch] <= APDS9960_CALIB_TARGET) {
+        hi[ch] = mid[ch];
+      } else {
+        lo[ch] = mid[ch] + 1;
+      }
+    }
+  }
+
+  cal->goffset_u = mgos_apds9960_offset_encode(lo[0]);
+  cal->goffset_d = mgos_apds9960_offset_encode(lo[1]);
+  cal->goffset_l = mgos_apds9960_offset_encode(lo[2]);
+  cal->goffset_r = mgos_apds9960_offset_encode(lo[3]);
+  return mgos_apds9960_calib_write_goffsets(sensor, lo);
+}
+
+bool mgos_apds9960_calibrate(struct mgos_apds9960 *sensor, struct mgos_apds9960_calibration *cal) {
+  uint8_t enable, config3, gconf4, gexth;
+  bool    ok;
+
+  if (!sensor || !cal) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &enable) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_CONFIG3, &config3) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_GEXTH, &gexth) ||
+      !mgos_apds9960_wireReadDataByte(sensor, APDS9960_GCONF4, &gconf4)) {
+    return false;
+  }
+
+  mgos_apds9960_reset_gesture_data(sensor);
+
+  // Proximity only, without interrupts or the ALS and wait states which would
+  // only stretch the cycle. Masking a whole pair needs no gain compensation.
+  ok = mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ENABLE, APDS9960_PON | APDS9960_PEN) &&
+       mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG3, config3 & ~0b00101111) &&
+       mgos_apds9960_calib_proximity_pair(sensor, APDS9960_POFFSET_UR, CALIB_PMASK_UR, &cal->poffset_ur) &&
+       mgos_apds9960_calib_proximity_pair(sensor, APDS9960_POFFSET_DL, CALIB_PMASK_DL, &cal->poffset_dl) &&
+       mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG3, config3) &&
+       mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ENABLE, APDS9960_PON | APDS9960_PEN | APDS9960_GEN) &&
+       mgos_apds9960_calib_gesture(sensor, cal);
+
+  // Restore the previous configuration, also on failure
+  mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ENABLE, 0);
+  mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG3, config3);
+  mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GEXTH, gexth);
+  mgos_apds9960_wireWriteDataByte(sensor, APDS9960_GCONF4, (gconf4 & ~APDS9960_GMODE) | APDS9960_GFIFO_CLR);
+  mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ENABLE, enable);
+  mgos_apds9960_reset_gesture_data(sensor);
+
+  if (!ok) {
+    LOG(LL_ERROR, ("Could not calibrate APDS9960 at I2C 0x%02x", sensor->i2caddr));
+    return false;
+  }
+  LOG(LL_INFO, ("APDS9960 at I2C 0x%02x calibrated: poffset=0x%02x/0x%02x goffset=0x%02x/0x%02x/0x%02x/0x%02x", sensor->i2caddr,
+                cal->poffset_ur, cal->poffset_dl, cal->goffset_u, cal->goffset_d, cal->goffset_l, cal->goffset_r));
+  return true;
+}
+
+bool mgos_apds9960_set_calibration(struct mgos_apds9960 *sensor, const struct mgos_apds9960_calibration *cal) {
+  struct mgos_apds9960_txn txn;
+
+  if (!sensor || !cal) {
+    return false;
+  }
+
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_write(&txn, APDS9960_POFFSET_UR, cal->poffset_ur);
+  mgos_apds9960_txn_write(&txn, APDS9960_POFFSET_DL, cal->poffset_dl);
+  mgos_apds9960_txn_write(&txn, APDS9960_GOFFSET_U, cal->goffset_u);
+  mgos_apds9960_txn_write(&txn, APDS9960_GOFFSET_D, cal->goffset_d);
+  mgos_apds9960_txn_write(&txn, APDS9960_GOFFSET_L, cal->goffset_l);
+  mgos_apds9960_txn_write(&txn, APDS9960_GOFFSET_R, cal->goffset_r);
+  return mgos_apds9960_txn_commit(&txn);
+}
+
+bool mgos_apds9960_get_calibration(struct mgos_apds9960 *sensor, struct mgos_apds9960_calibration *cal) {
+  struct mgos_apds9960_txn txn;
+
+  if (!sensor || !cal) {
+    return false;
+  }
+
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_read(&txn, APDS9960_POFFSET_UR, &cal->poffset_ur);
+  mgos_apds9960_txn_read(&txn, APDS9960_POFFSET_DL, &cal->poffset_dl);
+  mgos_apds9960_txn_read(&txn, APDS9960_GOFFSET_U, &cal->goffset_u);
+  mgos_apds9960_txn_read(&txn, APDS9960_GOFFSET_D, &cal->goffset_d);
+  mgos_apds9960_txn_read(&txn, APDS9960_GOFFSET_L, &cal->goffset_l);
+  mgos_apds9960_txn_read(&txn, APDS9960_GOFFSET_R, &cal->goffset_r);
+  return mgos_apds9960_txn_commit(&txn);
+}
+
+bool mgos_apds9960_save_calibration(const struct mgos_apds9960_calibration *cal) {
+  char *msg = NULL;
+
+  if (!cal) {
+    return false;
+  }
+
+  mgos_sys_config_set_apds9960_calib_enable(true);
+  mgos_sys_config_set_apds9960_calib_poffset_ur(cal->poffset_ur);
+  mgos_sys_config_set_apds9960_calib_poffset_dl(cal->poffset_dl);
+  mgos_sys_config_set_apds9960_calib_goffset_u(cal->goffset_u);
+  mgos_sys_config_set_apds9960_calib_goffset_d(cal->goffset_d);
+  mgos_sys_config_set_apds9960_calib_goffset_l(cal->goffset_l);
+  mgos_sys_config_set_apds9960_calib_goffset_r(cal->goffset_r);
+  if (!save_cfg(&mgos_sys_config, &msg)) {
+    LOG(LL_ERROR, ("Could not save APDS9960 calibration: %s", msg ? msg : ""));
+    free(msg);
+    return false;
+  }
+  return true;
+}
+
+bool mgos_apds9960_load_calibration(struct mgos_apds9960_calibration *cal) {
+  if (!cal || !mgos_sys_config_get_apds9960_calib_enable()) {
+    return false;
+  }
+
+  cal->poffset_ur = mgos_sys_config_get_apds9960_calib_poffset_ur();
+  cal->poffset_dl = mgos_sys_config_get_apds9960_calib_poffset_dl();
+  cal->goffset_u  = mgos_sys_config_get_apds9960_calib_goffset_u();
+  cal->goffset_d  = mgos_sys_config_get_apds9960_calib_goffset_d();
+  cal->goffset_l  = mgos_sys_config_get_apds9960_calib_goffset_l();
+  cal->goffset_r  = mgos_sys_config_get_apds9960_calib_goffset_r();
+  return true;
+}
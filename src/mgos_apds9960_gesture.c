@@ -0,0 +1,358 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+bool mgos_apds9960_is_gesture_available(struct mgos_apds9960 *sensor) {
+  uint8_t val;
+
+  if (!sensor) {
+    return false;
+  }
+
+  if (!mgos_apds9960_wireReadDataByte(sensor, APDS9960_GSTATUS, &val)) {
+    return false;
+  }
+
+  val &= APDS9960_GVALID;
+
+  return val == 1;
+}
+
+static const uint8_t s_gfifoth_datasets[] = { 1, 4, 8, 16 };
+
+// Pick the largest GFIFOTH which still leaves room in the FIFO for twice the
+// backlog that accumulates between the interrupt and the drain. Larger
+// thresholds mean fewer interrupts per gesture, smaller ones mean more room
+// to absorb interrupt latency.
+static void mgos_apds9960_gesture_autotune(struct mgos_apds9960 *sensor, uint32_t backlog) {
+  uint32_t backlog_x16 = backlog * 16;
+  uint8_t  threshold;
+  uint8_t  current;
+
+  // Fast attack, slow decay
+  if (backlog_x16 > sensor->gesture_backlog_x16) {
+    sensor->gesture_backlog_x16 = backlog_x16;
+  } else {
+    sensor->gesture_backlog_x16 = (sensor->gesture_backlog_x16 * 7 + backlog_x16) / 8;
+  }
+
+  threshold = APDS9960_GFIFOTH_16;
+  while (threshold > APDS9960_GFIFOTH_1 &&
+         s_gfifoth_datasets[threshold] * 16 + 2 * sensor->gesture_backlog_x16 > APDS9960_GESTURE_FIFO_SIZE * 16) {
+    threshold--;
+  }
+
+  if (!mgos_apds9960_get_gesture_fifo_threshold(sensor, &current) || current == threshold) {
+    return;
+  }
+  LOG(LL_DEBUG, ("Gesture FIFO threshold %u -> %u datasets", s_gfifoth_datasets[current], s_gfifoth_datasets[threshold]));
+  mgos_apds9960_set_gesture_fifo_threshold(sensor, threshold);
+}
+
+// Drain the gesture FIFO straight into the sensor's ring buffer, using one
+// block read (two if the ring wraps around), sized to GFLVL. On GFOV the
+// number of lost datasets is estimated from the observed dataset period.
+// Returns the number of datasets drained, or -1 on error.
+int mgos_apds9960_gesture_drain(struct mgos_apds9960 *sensor) {
+  struct mgos_apds9960_gesture_drain_stats *stats;
+  uint8_t  level_status[2];
+  uint8_t  threshold = APDS9960_GFIFOTH_4;
+  uint32_t level, remaining;
+  int64_t  now;
+
+  if (!sensor) {
+    return -1;
+  }
+  stats = &sensor->gesture_drain_stats;
+
+  // GFLVL (0xAE) and GSTATUS (0xAF) in one burst
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_GFLVL, level_status, sizeof(level_status)) != sizeof(level_status)) {
+    return -1;
+  }
+  now   = mgos_uptime_micros();
+  level = level_status[0];
+  if (level > APDS9960_GESTURE_FIFO_SIZE) {
+    level = APDS9960_GESTURE_FIFO_SIZE;
+  }
+  mgos_apds9960_get_gesture_fifo_threshold(sensor, &threshold);
+
+  stats->datasets       = level;
+  stats->overflow       = (level_status[1] & APDS9960_GFOV) != 0;
+  stats->lost           = 0;
+  stats->fifo_threshold = s_gfifoth_datasets[threshold];
+  if (stats->overflow) {
+    uint32_t produced = 0;
+
+    if (sensor->gesture_period_us > 0 && sensor->gesture_drain_us > 0) {
+      produced = (uint32_t)((now - sensor->gesture_drain_us) / sensor->gesture_period_us);
+    }
+    stats->lost        = produced > APDS9960_GESTURE_FIFO_SIZE ? produced - APDS9960_GESTURE_FIFO_SIZE : 1;
+    stats->lost_total += stats->lost;
+    sensor->gesture_fifo_overflows++;
+    LOG(LL_WARN, ("Gesture FIFO overflow at I2C 0x%02x, ~%u datasets lost", sensor->i2caddr, stats->lost));
+  } else if (level > 0 && sensor->gesture_start_us > 0 && sensor->gesture_drain_us > 0) {
+    // Only drains within one gesture say anything about the dataset period
+    uint32_t period = (uint32_t)((now - sensor->gesture_drain_us) / level);
+    sensor->gesture_period_us = sensor->gesture_period_us ? (sensor->gesture_period_us * 3 + period) / 4 : period;
+  }
+
+  if (sensor->gesture_irq_us > 0) {
+    stats->irq_latency_us  = (uint32_t)(now - sensor->gesture_irq_us);
+    sensor->gesture_irq_us = 0;
+    if (sensor->gesture_fifo_autotune) {
+      uint32_t backlog = stats->overflow ? APDS9960_GESTURE_FIFO_SIZE : 0;
+      if (!stats->overflow && level > stats->fifo_threshold) {
+        backlog = level - stats->fifo_threshold;
+      }
+      mgos_apds9960_gesture_autotune(sensor, backlog);
+    }
+  }
+  if (level > 0) {
+    sensor->gesture_drain_us = now;
+  }
+
+  remaining = level;
+  while (remaining > 0) {
+    uint32_t idx   = sensor->gesture_ring_head & (APDS9960_GESTURE_RING_SIZE - 1);
+    uint32_t chunk = APDS9960_GESTURE_RING_SIZE - idx;
+    int      len;
+
+    if (chunk > remaining) {
+      chunk = remaining;
+    }
+    len = chunk * sizeof(struct mgos_apds9960_gesture_dataset);
+    if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_GFIFO_U, (uint8_t *)&sensor->gesture_ring[idx], len) != len) {
+      return -1;
+    }
+    sensor->gesture_ring_head += chunk;
+    remaining                 -= chunk;
+  }
+
+  return level;
+}
+
+bool mgos_apds9960_set_gesture_fifo_autotune(struct mgos_apds9960 *sensor, bool enable) {
+  if (!sensor) {
+    return false;
+  }
+  sensor->gesture_fifo_autotune = enable;
+  sensor->gesture_backlog_x16   = 0;
+  return true;
+}
+
+bool mgos_apds9960_get_gesture_drain_stats(struct mgos_apds9960 *sensor, struct mgos_apds9960_gesture_drain_stats *stats) {
+  if (!sensor || !stats) {
+    return false;
+  }
+  *stats = sensor->gesture_drain_stats;
+  return true;
+}
+
+void mgos_apds9960_gesture_cursor_init(struct mgos_apds9960 *sensor, struct mgos_apds9960_gesture_cursor *cursor) {
+  if (!sensor || !cursor) {
+    return;
+  }
+  cursor->pos  = sensor->gesture_ring_head;
+  cursor->lost = 0;
+}
+
+// Return the number of contiguous datasets available to `cursor`, and point
+// *data at the first of them inside the ring. The datasets stay valid until
+// the next FIFO drain. A consumer which fell more than a ring behind is moved
+// up to the oldest retained dataset, and the skipped ones are added to
+// cursor->lost.
+size_t mgos_apds9960_gesture_peek(struct mgos_apds9960 *sensor, struct mgos_apds9960_gesture_cursor *cursor, const struct mgos_apds9960_gesture_dataset **data) {
+  uint32_t avail, idx, contiguous;
+
+  if (!sensor || !cursor || !data) {
+    return 0;
+  }
+
+  avail = sensor->gesture_ring_head - cursor->pos;
+  if (avail > APDS9960_GESTURE_RING_SIZE) {
+    cursor->lost += avail - APDS9960_GESTURE_RING_SIZE;
+    cursor->pos   = sensor->gesture_ring_head - APDS9960_GESTURE_RING_SIZE;
+    avail         = APDS9960_GESTURE_RING_SIZE;
+  }
+  if (avail == 0) {
+    return 0;
+  }
+
+  idx        = cursor->pos & (APDS9960_GESTURE_RING_SIZE - 1);
+  contiguous = APDS9960_GESTURE_RING_SIZE - idx;
+  if (contiguous > avail) {
+    contiguous = avail;
+  }
+  *data = &sensor->gesture_ring[idx];
+  return contiguous;
+}
+
+void mgos_apds9960_gesture_consume(struct mgos_apds9960_gesture_cursor *cursor, size_t count) {
+  if (!cursor) {
+    return;
+  }
+  cursor->pos += count;
+}
+
+uint32_t mgos_apds9960_get_gesture_fifo_overflows(struct mgos_apds9960 *sensor) {
+  if (!sensor) {
+    return 0;
+  }
+  return sensor->gesture_fifo_overflows;
+}
+
+void mgos_apds9960_reset_gesture_data(struct mgos_apds9960 *sensor) {
+  int flushed;
+
+  if (!sensor) {
+    return;
+  }
+  if (sensor->gesture_engine) {
+    sensor->gesture_engine->reset(sensor->gesture_engine_ctx);
+  }
+  sensor->gesture_start_us = 0;
+  sensor->gesture_data_us  = 0;
+  if (sensor->gesture_timer != MGOS_INVALID_TIMER_ID) {
+    mgos_clear_timer(sensor->gesture_timer);
+    sensor->gesture_timer = MGOS_INVALID_TIMER_ID;
+  }
+
+  // Flushed datasets still go through the ring for stream consumers, but the
+  // decoder skips past them. Bounded, as a hand in front of the sensor keeps
+  // the FIFO filling up.
+  for (int i = 0; i < 4; i++) {
+    flushed = mgos_apds9960_gesture_drain(sensor);
+    if (flushed <= 0) {
+      break;
+    }
+    LOG(LL_INFO, ("Flushed %d datasets from Gesture FIFO", flushed));
+  }
+  mgos_apds9960_gesture_cursor_init(sensor, &sensor->gesture_cursor);
+  sensor->gesture_drain_us = 0;
+  return;
+}
+
+// Feed the datasets which arrived in the ring since the last step to the
+// gesture engine. Datasets drained together are spread back in time by the
+// measured dataset period, so the engine sees their acquisition times.
+// Returns true once the engine recognized a gesture.
+static bool mgos_apds9960_gesture_feed(struct mgos_apds9960 *sensor, int64_t now, struct mgos_apds9960_gesture *result) {
+  const struct mgos_apds9960_gesture_dataset *data;
+  size_t n;
+
+  if (!sensor->gesture_engine) {
+    return false;
+  }
+
+  while ((n = mgos_apds9960_gesture_peek(sensor, &sensor->gesture_cursor, &data)) > 0) {
+    uint32_t remaining = sensor->gesture_ring_head - sensor->gesture_cursor.pos;
+
+    for (size_t i = 0; i < n; i++) {
+      int64_t time_us = now - (int64_t)(remaining - 1 - i) * sensor->gesture_period_us;
+
+      if (sensor->gesture_engine->feed(sensor->gesture_engine_ctx, &data[i], time_us, result)) {
+        mgos_apds9960_gesture_consume(&sensor->gesture_cursor, i + 1);
+        return true;
+      }
+    }
+    mgos_apds9960_gesture_consume(&sensor->gesture_cursor, n);
+  }
+  return false;
+}
+
+// One non-blocking decoder step: drains whatever the FIFO holds right now into
+// the ring and feeds it to the gesture engine, whose state lives in the sensor
+// between calls. Once no data arrived for APDS9960_GESTURE_IDLE_TIMEOUT, or
+// the gesture took longer than APDS9960_GESTURE_TIMEOUT, the engine is asked
+// to decide on what it has seen.
+bool mgos_apds9960_read_gesture(struct mgos_apds9960 *sensor, enum mgos_apds9960_direction_t *direction) {
+  struct mgos_apds9960_gesture result;
+  bool    decided = false;
+  int     drained;
+  int64_t now;
+
+  if (!sensor || !direction) {
+    return false;
+  }
+  *direction = APDS9960_DIR_NONE;
+
+  now     = mgos_uptime_micros();
+  drained = mgos_apds9960_gesture_drain(sensor);
+  if (drained < 0) {
+    LOG(LL_ERROR, ("Could not read Gesture FIFO"));
+    return false;
+  }
+  if (drained > 0) {
+    if (sensor->gesture_stream_handler) {
+      sensor->gesture_stream_handler(sensor);
+    }
+    if (sensor->gesture_start_us == 0) {
+      sensor->gesture_start_us = now;
+    }
+    sensor->gesture_data_us = now;
+    decided                 = mgos_apds9960_gesture_feed(sensor, now, &result);
+  }
+
+  if (!decided && sensor->gesture_start_us > 0 &&
+      (now - sensor->gesture_data_us > APDS9960_GESTURE_IDLE_TIMEOUT * 1000 ||
+       now - sensor->gesture_start_us > APDS9960_GESTURE_TIMEOUT * 1000)) {
+    decided = sensor->gesture_engine && sensor->gesture_engine->finish(sensor->gesture_engine_ctx, now, &result);
+    if (!decided) {
+      LOG(LL_DEBUG, ("Gesture not recognized"));
+      mgos_apds9960_reset_gesture_data(sensor);
+    }
+  }
+
+  if (decided) {
+    sensor->last_gesture = result;
+    *direction           = result.direction;
+    mgos_apds9960_reset_gesture_data(sensor);
+  }
+  return true;
+}
+
+static void mgos_apds9960_gesture_timer_cb(void *arg) {
+  struct mgos_apds9960 *sensor = (struct mgos_apds9960 *)arg;
+
+  sensor->gesture_timer = MGOS_INVALID_TIMER_ID;
+  mgos_apds9960_gesture_poll(sensor);
+}
+
+// Run a decoder step and emit the gesture to the handler as soon as it is
+// decided. While a gesture is in progress, a timer keeps stepping the decoder
+// in case the FIFO does not fill up to GFIFOTH again.
+void mgos_apds9960_gesture_poll(struct mgos_apds9960 *sensor) {
+  enum mgos_apds9960_direction_t direction = APDS9960_DIR_NONE;
+
+  if (!sensor) {
+    return;
+  }
+
+  if (!mgos_apds9960_read_gesture(sensor, &direction)) {
+    LOG(LL_WARN, ("Could not read gesture"));
+  }
+  if (direction != APDS9960_DIR_NONE) {
+    if (sensor->gesture_handler) {
+      sensor->gesture_handler(direction);
+    }
+    return;
+  }
+
+  if (sensor->gesture_start_us > 0 && sensor->gesture_timer == MGOS_INVALID_TIMER_ID) {
+    sensor->gesture_timer = mgos_set_timer(APDS9960_FIFO_PAUSE_TIME, 0, mgos_apds9960_gesture_timer_cb, sensor);
+  }
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+/*
+ * Built-in gesture engine. A gesture is the run of datasets in which all four
+ * photodiodes exceed the threshold. The up/down and left/right ratios,
+ * (U-D)*100/(U+D) and (L-R)*100/(L+R), are taken at entry and exit of that
+ * run; a target passing across the sensor swings them by up to 200 percent in
+ * the direction of motion. A target approaching or receding without lateral
+ * motion instead shows up as a change in total signal between entry and exit,
+ * relative to the peak. Everything is computed in integer arithmetic.
+ */
+
+static int iabs(int v) {
+  return v < 0 ? -v : v;
+}
+
+static uint8_t clamp_confidence(int v) {
+  return v > 100 ? 100 : (v < 0 ? 0 : v);
+}
+
+// Ratio swing (or signal change), in percent, per second
+static uint16_t rate_per_second(int percent, uint32_t duration_ms) {
+  uint32_t rate;
+
+  if (duration_ms == 0) {
+    return 0xFFFF;
+  }
+  rate = (uint32_t)percent * 1000 / duration_ms;
+  return rate > 0xFFFF ? 0xFFFF : rate;
+}
+
+static void mgos_apds9960_trajectory_reset(void *ctx) {
+  struct mgos_apds9960_trajectory *t = (struct mgos_apds9960_trajectory *)ctx;
+  uint8_t threshold            = t->threshold;
+  uint8_t sensitivity          = t->sensitivity;
+  uint8_t near_far_sensitivity = t->near_far_sensitivity;
+
+  memset(t, 0, sizeof(*t));
+  t->threshold            = threshold;
+  t->sensitivity          = sensitivity;
+  t->near_far_sensitivity = near_far_sensitivity;
+}
+
+static bool mgos_apds9960_trajectory_decide(struct mgos_apds9960_trajectory *t, struct mgos_apds9960_gesture *result) {
+  int      ud_delta, lr_delta, dom, minor;
+  uint32_t duration_ms;
+
+  if (!t->active) {
+    return false;
+  }
+
+  ud_delta    = t->last_ud - t->first_ud;
+  lr_delta    = t->last_lr - t->first_lr;
+  dom         = iabs(ud_delta) > iabs(lr_delta) ? iabs(ud_delta) : iabs(lr_delta);
+  minor       = iabs(ud_delta) > iabs(lr_delta) ? iabs(lr_delta) : iabs(ud_delta);
+  duration_ms = (uint32_t)((t->last_us - t->first_us) / 1000);
+  t->active   = false;
+
+  memset(result, 0, sizeof(*result));
+  result->direction   = APDS9960_DIR_NONE;
+  result->duration_ms = duration_ms;
+
+  if (dom >= t->sensitivity) {
+    if (minor >= t->sensitivity && minor * 4 >= dom * 3) {
+      // Strong motion on both axes, neither of them dominant
+      result->direction  = APDS9960_DIR_ALL;
+      result->confidence = clamp_confidence(minor * 50 / t->sensitivity);
+    } else {
+      if (iabs(ud_delta) >= iabs(lr_delta)) {
+        result->direction = ud_delta > 0 ? APDS9960_DIR_DOWN : APDS9960_DIR_UP;
+      } else {
+        result->direction = lr_delta > 0 ? APDS9960_DIR_RIGHT : APDS9960_DIR_LEFT;
+      }
+      result->confidence = clamp_confidence(dom * 50 / t->sensitivity * (dom - minor) / dom);
+    }
+    result->speed = rate_per_second(dom, duration_ms);
+  } else if (t->peak_total > 0) {
+    int rise = ((int)t->last_total - (int)t->first_total) * 100 / t->peak_total;
+
+    if (iabs(rise) >= t->near_far_sensitivity) {
+      result->direction  = rise > 0 ? APDS9960_DIR_NEAR : APDS9960_DIR_FAR;
+      result->confidence = clamp_confidence(iabs(rise) * 50 / t->near_far_sensitivity);
+      result->speed      = rate_per_second(iabs(rise), duration_ms);
+    }
+  }
+
+  LOG(LL_DEBUG, ("Gesture ud_delta=%d lr_delta=%d direction=%d confidence=%u duration=%ums",
+                 ud_delta, lr_delta, result->direction, result->confidence, duration_ms));
+  return result->direction != APDS9960_DIR_NONE;
+}
+
+static bool mgos_apds9960_trajectory_feed(void *ctx, const struct mgos_apds9960_gesture_dataset *d, int64_t time_us, struct mgos_apds9960_gesture *result) {
+  struct mgos_apds9960_trajectory *t = (struct mgos_apds9960_trajectory *)ctx;
+  uint16_t total;
+
+  if (d->up <= t->threshold || d->down <= t->threshold || d->left <= t->threshold || d->right <= t->threshold) {
+    // Signal fell off: the gesture has exited
+    return mgos_apds9960_trajectory_decide(t, result);
+  }
+
+  total = (uint16_t)d->up + d->down + d->left + d->right;
+  if (!t->active) {
+    t->active      = true;
+    t->first_ud    = ((int)d->up - (int)d->down) * 100 / ((int)d->up + (int)d->down);
+    t->first_lr    = ((int)d->left - (int)d->right) * 100 / ((int)d->left + (int)d->right);
+    t->first_total = total;
+    t->peak_total  = 0;
+    t->first_us    = time_us;
+  }
+  t->last_ud    = ((int)d->up - (int)d->down) * 100 / ((int)d->up + (int)d->down);
+  t->last_lr    = ((int)d->left - (int)d->right) * 100 / ((int)d->left + (int)d->right);
+  t->last_total = total;
+  t->last_us    = time_us;
+  if (total > t->peak_total) {
+    t->peak_total = total;
+  }
+  return false;
+}
+
+static bool mgos_apds9960_trajectory_finish(void *ctx, int64_t time_us, struct mgos_apds9960_gesture *result) {
+  (void)time_us;
+  return mgos_apds9960_trajectory_decide((struct mgos_apds9960_trajectory *)ctx, result);
+}
+
+const struct mgos_apds9960_gesture_engine mgos_apds9960_trajectory_engine = {
+  .reset  = mgos_apds9960_trajectory_reset,
+  .feed   = mgos_apds9960_trajectory_feed,
+  .finish = mgos_apds9960_trajectory_finish,
+};
+
+bool mgos_apds9960_set_gesture_engine(struct mgos_apds9960 *sensor, const struct mgos_apds9960_gesture_engine *engine, void *ctx) {
+  if (!sensor) {
+    return false;
+  }
+  if (engine && (!engine->reset || !engine->feed || !engine->finish)) {
+    return false;
+  }
+
+  if (!engine) {
+    engine = &mgos_apds9960_trajectory_engine;
+    ctx    = &sensor->gesture_trajectory;
+  }
+  sensor->gesture_engine     = engine;
+  sensor->gesture_engine_ctx = ctx;
+  engine->reset(ctx);
+  return true;
+}
+
+bool mgos_apds9960_set_gesture_sensitivity(struct mgos_apds9960 *sensor, uint8_t threshold, uint8_t sensitivity) {
+  if (!sensor || sensitivity == 0 || sensitivity > 200) {
+    return false;
+  }
+  sensor->gesture_trajectory.threshold   = threshold;
+  sensor->gesture_trajectory.sensitivity = sensitivity;
+  return true;
+}
+
+bool mgos_apds9960_get_last_gesture(struct mgos_apds9960 *sensor, struct mgos_apds9960_gesture *gesture) {
+  if (!sensor || !gesture) {
+    return false;
+  }
+  *gesture = sensor->last_gesture;
+  return true;
+}
@@ -16,66 +16,223 @@
 
 #include "mgos_apds9960_internal.h"
 
+#define SHADOW_BIT(reg)    (1ULL << ((reg) - APDS9960_SHADOW_BASE))
+
+// Registers which are only ever changed by the host, and can therefore be
+// served from the shadow copy. GCONF4 is deliberately absent: the gesture
+// engine sets and clears GMODE on its own.
+static const uint64_t s_shadowed_regs =
+  SHADOW_BIT(APDS9960_ENABLE) | SHADOW_BIT(APDS9960_ATIME) | SHADOW_BIT(APDS9960_WTIME) |
+  SHADOW_BIT(APDS9960_AILTL) | SHADOW_BIT(APDS9960_AILTH) | SHADOW_BIT(APDS9960_AIHTL) | SHADOW_BIT(APDS9960_AIHTH) |
+  SHADOW_BIT(APDS9960_PILT) | SHADOW_BIT(APDS9960_PIHT) | SHADOW_BIT(APDS9960_PERS) |
+  SHADOW_BIT(APDS9960_CONFIG1) | SHADOW_BIT(APDS9960_PPULSE) | SHADOW_BIT(APDS9960_CONTROL) | SHADOW_BIT(APDS9960_CONFIG2) |
+  SHADOW_BIT(APDS9960_POFFSET_UR) | SHADOW_BIT(APDS9960_POFFSET_DL) | SHADOW_BIT(APDS9960_CONFIG3) |
+  SHADOW_BIT(APDS9960_GPENTH) | SHADOW_BIT(APDS9960_GEXTH) | SHADOW_BIT(APDS9960_GCONF1) | SHADOW_BIT(APDS9960_GCONF2) |
+  SHADOW_BIT(APDS9960_GOFFSET_U) | SHADOW_BIT(APDS9960_GOFFSET_D) | SHADOW_BIT(APDS9960_GPULSE) |
+  SHADOW_BIT(APDS9960_GOFFSET_L) | SHADOW_BIT(APDS9960_GOFFSET_R) | SHADOW_BIT(APDS9960_GCONF3);
+
+bool mgos_apds9960_reg_is_shadowed(uint8_t reg) {
+  if (reg < APDS9960_SHADOW_BASE || reg >= APDS9960_SHADOW_BASE + APDS9960_SHADOW_SIZE) {
+    return false;
+  }
+  return (s_shadowed_regs & SHADOW_BIT(reg)) != 0;
+}
+
+void mgos_apds9960_shadow_store(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *val, unsigned int len) {
+  if (!sensor || !val) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < len; i++, reg++) {
+    if (mgos_apds9960_reg_is_shadowed(reg)) {
+      sensor->shadow[reg - APDS9960_SHADOW_BASE] = val[i];
+      sensor->shadow_valid |= SHADOW_BIT(reg);
+    }
+    if (reg == 0xFF) {
+      break;
+    }
+  }
+}
+
+void mgos_apds9960_shadow_invalidate(struct mgos_apds9960 *sensor) {
+  if (!sensor) {
+    return;
+  }
+  sensor->shadow_valid = 0;
+}
+
+// Returns the shadow copy of `reg`, if one is held, without touching the bus
+bool mgos_apds9960_shadow_get(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val) {
+  if (!sensor || !val || !mgos_apds9960_reg_is_shadowed(reg) || !(sensor->shadow_valid & SHADOW_BIT(reg))) {
+    return false;
+  }
+  *val = sensor->shadow[reg - APDS9960_SHADOW_BASE];
+  return true;
+}
+
+// Returns the shadow copy of `reg` if one is held, and otherwise reads it from
+// the device (which populates the shadow copy for cacheable registers).
+bool mgos_apds9960_reg_read(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val) {
+  if (!sensor || !val) {
+    return false;
+  }
+
+  if (mgos_apds9960_shadow_get(sensor, reg, val)) {
+    return true;
+  }
+
+  return mgos_apds9960_wireReadDataByte(sensor, reg, val);
+}
+
+// Sensor the bus was last routed to by a bus_select callback
+static struct mgos_apds9960 *s_bus_selected = NULL;
+
+bool mgos_apds9960_bus_acquire(struct mgos_apds9960 *sensor) {
+  if (!sensor->bus_select || s_bus_selected == sensor) {
+    return true;
+  }
+  s_bus_selected = NULL;
+  if (!sensor->bus_select(sensor, sensor->bus_select_arg)) {
+    return false;
+  }
+  s_bus_selected = sensor;
+  return true;
+}
+
+void mgos_apds9960_bus_forget(struct mgos_apds9960 *sensor) {
+  if (s_bus_selected == sensor) {
+    s_bus_selected = NULL;
+  }
+}
+
+void mgos_apds9960_bus_release(void) {
+  s_bus_selected = NULL;
+}
+
+// Accounts one primitive call that started at `start_us`.
+static bool mgos_apds9960_i2c_account(struct mgos_apds9960 *sensor, int64_t start_us, unsigned int written, unsigned int read, bool ok) {
+  struct mgos_apds9960_i2c_stats *stats = &sensor->i2c_stats;
+  uint32_t latency = (uint32_t)(mgos_uptime_micros() - start_us);
+
+  stats->transactions++;
+  stats->latency_total_us += latency;
+  if (latency > stats->latency_max_us) {
+    stats->latency_max_us = latency;
+  }
+  if (!ok) {
+    stats->errors++;
+    return false;
+  }
+  stats->bytes_written += written;
+  stats->bytes_read    += read;
+  return true;
+}
+
+bool mgos_apds9960_get_i2c_stats(struct mgos_apds9960 *sensor, struct mgos_apds9960_i2c_stats *stats) {
+  if (!sensor || !stats) {
+    return false;
+  }
+  *stats = sensor->i2c_stats;
+  return true;
+}
+
+bool mgos_apds9960_reset_i2c_stats(struct mgos_apds9960 *sensor) {
+  if (!sensor) {
+    return false;
+  }
+  memset(&sensor->i2c_stats, 0, sizeof(sensor->i2c_stats));
+  return true;
+}
+
 bool mgos_apds9960_wireWriteByte(struct mgos_apds9960 *sensor, uint8_t val) {
+  int64_t start;
+  bool    ok;
+
   if (!sensor) {
     return false;
   }
 
-  return mgos_i2c_write(sensor->i2c, sensor->i2caddr, &val, 1, true);
+  start = mgos_uptime_micros();
+  ok    = mgos_apds9960_bus_acquire(sensor) && mgos_i2c_write(sensor->i2c, sensor->i2caddr, &val, 1, true);
+  return mgos_apds9960_i2c_account(sensor, start, 1, 0, ok);
 }
 
 bool mgos_apds9960_wireWriteDataByte(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t val) {
+  int64_t start;
+  bool    ok;
+
   if (!sensor) {
     return false;
   }
 
-  return mgos_i2c_write_reg_b(sensor->i2c, sensor->i2caddr, reg, val);
+  start = mgos_uptime_micros();
+  ok    = mgos_apds9960_bus_acquire(sensor) && mgos_i2c_write_reg_b(sensor->i2c, sensor->i2caddr, reg, val);
+  if (!mgos_apds9960_i2c_account(sensor, start, 2, 0, ok)) {
+    return false;
+  }
+
+  mgos_apds9960_shadow_store(sensor, reg, &val, 1);
+  return true;
 }
 
-bool mgos_apds9960_wireWriteDataBlock(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val, unsigned int len) {
+bool mgos_apds9960_wireWriteDataBlock(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *val, unsigned int len) {
+  int64_t start;
+  bool    ok;
+
   if (!sensor || !val) {
     return false;
   }
 
-  if (!mgos_i2c_write(sensor->i2c, sensor->i2caddr, &reg, 1, true)) {
+  // Register address and data must go out in one transaction for the device
+  // to auto-increment across the block.
+  start = mgos_uptime_micros();
+  ok    = mgos_apds9960_bus_acquire(sensor) && mgos_i2c_write_reg_n(sensor->i2c, sensor->i2caddr, reg, len, val);
+  if (!mgos_apds9960_i2c_account(sensor, start, 1 + len, 0, ok)) {
     mgos_i2c_stop(sensor->i2c);
     return false;
   }
 
-  return mgos_i2c_write(sensor->i2c, sensor->i2caddr, val, len, true);
+  mgos_apds9960_shadow_store(sensor, reg, val, len);
+  return true;
 }
 
 bool mgos_apds9960_wireReadDataByte(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val) {
-  int ret;
+  int64_t start;
+  int     ret;
 
   if (!sensor || !val) {
     return false;
   }
 
-  ret = mgos_i2c_read_reg_b(sensor->i2c, sensor->i2caddr, reg);
-  if (ret < 0) {
+  start = mgos_uptime_micros();
+  ret   = mgos_apds9960_bus_acquire(sensor) ? mgos_i2c_read_reg_b(sensor->i2c, sensor->i2caddr, reg) : -1;
+  if (!mgos_apds9960_i2c_account(sensor, start, 1, 1, ret >= 0)) {
     mgos_i2c_stop(sensor->i2c);
     return false;
   }
 
   *val = (uint8_t)ret;
+  mgos_apds9960_shadow_store(sensor, reg, val, 1);
   return true;
 }
 
 int mgos_apds9960_wireReadDataBlock(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val, unsigned int len) {
-  if (!sensor) {
-    return -1;
-  }
+  int64_t start;
+  bool    ok;
 
-  if (!mgos_i2c_write(sensor->i2c, sensor->i2caddr, &reg, 1, true)) {
-    mgos_i2c_stop(sensor->i2c);
+  if (!sensor) {
     return -1;
   }
 
-  if (!mgos_i2c_read(sensor->i2c, sensor->i2caddr, val, len, true)) {
+  start = mgos_uptime_micros();
+  ok    = mgos_apds9960_bus_acquire(sensor) &&
+          mgos_i2c_write(sensor->i2c, sensor->i2caddr, &reg, 1, true) &&
+          mgos_i2c_read(sensor->i2c, sensor->i2caddr, val, len, true);
+  if (!mgos_apds9960_i2c_account(sensor, start, 1, len, ok)) {
     mgos_i2c_stop(sensor->i2c);
     return -1;
   }
 
+  mgos_apds9960_shadow_store(sensor, reg, val, len);
   return len;
 }
@@ -40,6 +40,27 @@ extern "C" {
 
 /* Misc parameters */
 #define APDS9960_FIFO_PAUSE_TIME           30    // Wait period (ms) between FIFO reads
+#define APDS9960_GESTURE_IDLE_TIMEOUT      60    // Gesture has ended without FIFO data for this long (ms)
+#define APDS9960_GESTURE_TIMEOUT           1000  // Maximum gesture duration (ms)
+#define APDS9960_GESTURE_FIFO_SIZE         32    // Datasets held by the hardware FIFO
+#define APDS9960_GESTURE_RING_SIZE         64    // Datasets held per sensor, power of 2
+#define APDS9960_IRQ_GROUP_SIZE            8     // Sensors sharing one interrupt line
+#define APDS9960_IRQ_GROUP_PASSES          4     // Passes over a group before yielding
+#define APDS9960_IRQ_GROUP_BACKOFF_MS      10    // Wait before servicing a line still held low
+#define APDS9960_IRQ_GROUP_ROUNDS          10    // Back-offs before a line held low is left alone
+#define APDS9960_SAMPLER_SIZE              8     // Sensors read by one sampler
+#define APDS9960_SAMPLE_MARGIN_US          2000  // Slack on top of the expected conversion time
+#define APDS9960_CALIB_SAMPLES             4     // Readings averaged per calibration step
+#define APDS9960_CALIB_TARGET              2     // Residual counts accepted after calibration
+#define APDS9960_CALIB_TIMEOUT_MS          500   // Wait for gesture data during calibration
+#define APDS9960_CALIB_POLL_US             5000
+#define APDS9960_ASYNC_QUEUE_SIZE          16    // Pending asynchronous register operations, all sensors
+#define APDS9960_ASYNC_MAX_LEN             32    // Bytes per operation, and per coalesced transfer
+#define APDS9960_ASYNC_COALESCE            8     // Operations merged into one transfer at most
+#define APDS9960_ASYNC_BATCH               4     // Transfers per queue worker run before yielding
+#define APDS9960_TXN_SIZE                  32    // Register accesses collected by one transaction
+#define APDS9960_TXN_MAX_LEN               32    // Bytes per merged transfer
+#define APDS9960_TXN_MAX_GAP               3     // Registers bridged rather than starting a new transfer
 
 /* APDS-9960 register addresses */
 #define APDS9960_ENABLE                    0x80
@@ -92,6 +113,10 @@ extern "C" {
 #define APDS9960_GFIFO_L                   0xFE
 #define APDS9960_GFIFO_R                   0xFF
 
+/* Shadow register cache: ENABLE (0x80) through GCONF4 (0xAB) */
+#define APDS9960_SHADOW_BASE               APDS9960_ENABLE
+#define APDS9960_SHADOW_SIZE               (APDS9960_GCONF4 - APDS9960_ENABLE + 1)
+
 /* Bit fields */
 #define APDS9960_PON                       0b00000001
 #define APDS9960_AEN                       0b00000010
@@ -100,7 +125,13 @@ extern "C" {
 #define APSD9960_AIEN                      0b00010000
 #define APDS9960_PIEN                      0b00100000
 #define APDS9960_GEN                       0b01000000
+#define APDS9960_WLONG                     0b00000010
+#define APDS9960_CONFIG1_INIT              0b00100000  // Reserved, 0 after power-on-reset, set by init
 #define APDS9960_GVALID                    0b00000001
+#define APDS9960_GFOV                      0b00000010
+#define APDS9960_GMODE                     0b00000001
+#define APDS9960_GIEN_BIT                  0b00000010
+#define APDS9960_GFIFO_CLR                 0b00000100
 
 /* On/Off definitions */
 #define APDS9960_OFF                       0
@@ -140,6 +171,12 @@ extern "C" {
 #define APDS9960_GGAIN_4X                  2
 #define APDS9960_GGAIN_8X                  3
 
+/* Gesture FIFO threshold (GFIFOTH) values */
+#define APDS9960_GFIFOTH_1                 0
+#define APDS9960_GFIFOTH_4                 1
+#define APDS9960_GFIFOTH_8                 2
+#define APDS9960_GFIFOTH_16                3
+
 /* LED Boost values */
 #define APDS9960_LED_BOOST_100             0
 #define APDS9960_LED_BOOST_150             1
@@ -185,20 +222,132 @@ extern "C" {
 #define APDS9960_DEFAULT_GCONF3            0     // All photodiodes active during gesture
 #define APDS9960_DEFAULT_GIEN              0     // Disable gesture interrupts
 
+/* State of the built-in gesture engine, ratios are in percent */
+struct mgos_apds9960_trajectory {
+  uint8_t  threshold;
+  uint8_t  sensitivity;
+  uint8_t  near_far_sensitivity;
+  bool     active;
+  int16_t  first_ud;
+  int16_t  first_lr;
+  int16_t  last_ud;
+  int16_t  last_lr;
+  uint16_t first_total;
+  uint16_t last_total;
+  uint16_t peak_total;
+  int64_t  first_us;
+  int64_t  last_us;
+};
+
+extern const struct mgos_apds9960_gesture_engine mgos_apds9960_trajectory_engine;
+
 struct mgos_apds9960 {
   struct mgos_i2c *               i2c;
   uint8_t                         i2caddr;
+  int                             irq_pin;
+  struct mgos_apds9960_i2c_stats  i2c_stats;
+
+  /* Optional bus routing, see mgos_apds9960_create_mux() */
+  mgos_apds9960_bus_select_t      bus_select;
+  void *                          bus_select_arg;
 
   /* Handlers */
   mgos_apds9960_light_event_t     light_handler;
   mgos_apds9960_proximity_event_t proximity_handler;
   mgos_apds9960_gesture_event_t   gesture_handler;
+  mgos_apds9960_gesture_stream_event_t gesture_stream_handler;
+  mgos_apds9960_presence_event_t  presence_handler;
+
+  /* Light window re-centering, see mgos_apds9960_set_callback_light_change() */
+  bool                            light_change;
+  uint16_t                        light_delta;
+  uint8_t                         light_delta_pct;
+
+  /* Saturation interrupts, see mgos_apds9960_set_callback_saturation() */
+  mgos_apds9960_saturation_event_t saturation_handler;
+  uint8_t                         saturation_sources;   // APDS9960_STATUS_CPSAT and/or PGSAT
+  bool                            saturation_auto;
+
+  /* Proximity presence state, see mgos_apds9960_set_callback_presence() */
+  bool                            presence_near;
+  uint8_t                         presence_far_threshold;
+  uint8_t                         presence_near_threshold;
+
+  /* Shadow copy of the writable configuration registers, see
+   * mgos_apds9960_reg_read(). Bit N of shadow_valid covers register
+   * APDS9960_SHADOW_BASE + N.
+   */
+  uint8_t                         shadow[APDS9960_SHADOW_SIZE];
+  uint64_t                        shadow_valid;
+
+  /* Set while an interrupt is waiting for mgos_apds9960_irq_worker(). A
+   * sensor destroyed in the meantime is only marked, and freed by the worker.
+   */
+  bool                            irq_scheduled;
+  bool                            destroyed;
+  int64_t                         irq_us;
+  uint8_t                         irq_status;
+  struct mgos_apds9960_irq_group *irq_group;
+  struct mgos_apds9960_sampler *  sampler;
+
+  /* Light auto-ranging, see mgos_apds9960_read_light_normalized() */
+  bool                            als_autorange;
+  uint8_t                         als_settle;           // Conversions to discard after a range change
+  struct mgos_apds9960_lux_coef   lux_coef;
 
-  /* Private data for the driver */
-  int                             up_cnt;
-  int                             down_cnt;
-  int                             left_cnt;
-  int                             right_cnt;
+  /* Pending mgos_apds9960_read_sample_async() */
+  mgos_apds9960_sample_event_t    sample_handler;
+  void *                          sample_arg;
+  uint8_t                         sample_valid;
+  int64_t                         sample_deadline_us;
+  mgos_timer_id                   sample_timer;
+
+  /* Incremental gesture decoder, see mgos_apds9960_read_gesture() */
+  const struct mgos_apds9960_gesture_engine *gesture_engine;
+  void *                          gesture_engine_ctx;
+  struct mgos_apds9960_trajectory gesture_trajectory;
+  struct mgos_apds9960_gesture    last_gesture;
+  int64_t                         gesture_start_us;
+  int64_t                         gesture_data_us;
+  mgos_timer_id                   gesture_timer;
+  struct mgos_apds9960_gesture_cursor gesture_cursor;
+
+  /* Gesture FIFO is drained into this ring, gesture_ring_head counts all
+   * datasets ever written to it. */
+  struct mgos_apds9960_gesture_dataset gesture_ring[APDS9960_GESTURE_RING_SIZE];
+  uint32_t                        gesture_ring_head;
+  uint32_t                        gesture_fifo_overflows;
+
+  /* FIFO drain accounting and GFIFOTH auto-tuning */
+  struct mgos_apds9960_gesture_drain_stats gesture_drain_stats;
+  int64_t                         gesture_irq_us;       // Pending gesture interrupt, 0 if none
+  int64_t                         gesture_drain_us;     // Time of the last drain
+  uint32_t                        gesture_period_us;    // Estimated time per dataset
+  uint16_t                        gesture_backlog_x16;  // Datasets queued beyond GFIFOTH at drain time, x16
+  bool                            gesture_fifo_autotune;
+};
+
+/* Decode CDATAL..BDATAH as read in one burst */
+static inline void mgos_apds9960_decode_rgbc(const uint8_t *data, struct mgos_apds9960_rgbc *rgbc) {
+  rgbc->clear = ((uint16_t)data[1] << 8) | data[0];
+  rgbc->red   = ((uint16_t)data[3] << 8) | data[2];
+  rgbc->green = ((uint16_t)data[5] << 8) | data[4];
+  rgbc->blue  = ((uint16_t)data[7] << 8) | data[6];
+}
+
+/* Register transaction, see mgos_apds9960_txn_commit() */
+struct mgos_apds9960_txn_op {
+  uint8_t   reg;
+  uint8_t   val;                  // Value to write
+  bool      write;
+  uint8_t * dst;                  // Destination of a read
+};
+
+struct mgos_apds9960_txn {
+  struct mgos_apds9960 *      sensor;
+  uint8_t                     num_ops;
+  bool                        overflow;
+  struct mgos_apds9960_txn_op ops[APDS9960_TXN_SIZE];
 };
 
 /* Mongoose OS intiializer */
@@ -207,14 +356,39 @@ bool mgos_apds9960_i2c_init(void);
 /* Private methods */
 void mgos_apds9960_reset_gesture_data(struct mgos_apds9960 *sensor);
 void mgos_apds9960_irq(int pin, void *arg);
+void mgos_apds9960_irq_worker(void *arg);
+bool mgos_apds9960_irq_service(struct mgos_apds9960 *sensor, int64_t irq_us);
+void mgos_apds9960_gesture_poll(struct mgos_apds9960 *sensor);
+int mgos_apds9960_gesture_drain(struct mgos_apds9960 *sensor);
+bool mgos_apds9960_als_step_down(struct mgos_apds9960 *sensor);
+void mgos_apds9960_async_cancel(struct mgos_apds9960 *sensor);
+uint32_t mgos_apds9960_pulse_time_us(uint8_t pulse);
 
 /* I2C Primitives */
+bool mgos_apds9960_bus_acquire(struct mgos_apds9960 *sensor);
+void mgos_apds9960_bus_forget(struct mgos_apds9960 *sensor);
 bool mgos_apds9960_wireWriteByte(struct mgos_apds9960 *sensor, uint8_t val);
 bool mgos_apds9960_wireWriteDataByte(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t val);
-bool mgos_apds9960_wireWriteDataBlock(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val, unsigned int len);
+bool mgos_apds9960_wireWriteDataBlock(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *val, unsigned int len);
 bool mgos_apds9960_wireReadDataByte(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val);
 int mgos_apds9960_wireReadDataBlock(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val, unsigned int len);
 
+/* Shadow register cache */
+bool mgos_apds9960_reg_is_shadowed(uint8_t reg);
+bool mgos_apds9960_reg_read(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val);
+void mgos_apds9960_shadow_store(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *val, unsigned int len);
+void mgos_apds9960_shadow_invalidate(struct mgos_apds9960 *sensor);
+bool mgos_apds9960_shadow_get(struct mgos_apds9960 *sensor, uint8_t reg, uint8_t *val);
+
+/* Register transactions */
+void mgos_apds9960_txn_init(struct mgos_apds9960_txn *txn, struct mgos_apds9960 *sensor);
+bool mgos_apds9960_txn_write(struct mgos_apds9960_txn *txn, uint8_t reg, uint8_t val);
+bool mgos_apds9960_txn_write_block(struct mgos_apds9960_txn *txn, uint8_t reg, const uint8_t *val, unsigned int len);
+bool mgos_apds9960_txn_read(struct mgos_apds9960_txn *txn, uint8_t reg, uint8_t *dst);
+bool mgos_apds9960_txn_read_block(struct mgos_apds9960_txn *txn, uint8_t reg, uint8_t *dst, unsigned int len);
+bool mgos_apds9960_txn_commit(struct mgos_apds9960_txn *txn);
+bool mgos_apds9960_txn_bridge(struct mgos_apds9960 *sensor, uint8_t reg, bool write, uint8_t *val);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,192 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+struct mgos_apds9960_irq_group {
+  int                   irq_pin;
+  struct mgos_apds9960 *sensors[APDS9960_IRQ_GROUP_SIZE];
+  uint8_t               num_sensors;
+  uint8_t               next;       // Round-robin start of the next pass
+  bool                  scheduled;  // Worker pending, from an edge or a back-off
+  mgos_timer_id         backoff_timer;
+  uint8_t               rounds;     // Back-offs with the line held low throughout
+  bool                  destroyed;  // Freed by the pending worker
+  int64_t               irq_us;
+};
+
+static void mgos_apds9960_irq_group_worker(void *arg);
+
+static void mgos_apds9960_irq_group_schedule(struct mgos_apds9960_irq_group *group) {
+  group->scheduled = true;
+  if (!mgos_invoke_cb(mgos_apds9960_irq_group_worker, group, false)) {
+    LOG(LL_ERROR, ("Could not schedule APDS9960 interrupt worker"));
+    group->scheduled = false;
+  }
+}
+
+static void mgos_apds9960_irq_group_irq(int pin, void *arg) {
+  struct mgos_apds9960_irq_group *group = (struct mgos_apds9960_irq_group *)arg;
+
+  if (!group || group->scheduled) {
+    return;
+  }
+  group->irq_us = mgos_uptime_micros();
+  group->rounds = 0;
+  mgos_apds9960_irq_group_schedule(group);
+  (void)pin;
+}
+
+// Services every sensor once per pass, starting one further along each time
+// so that a sensor which keeps interrupting cannot starve the others. The
+// line is edge triggered and open-drain, so it is checked again after each
+// pass: while any sensor still holds it low, no new edge would be seen.
+// A line which stays low regardless (a gesture interrupt without a gesture
+// handler, a device outside the group, a fault) is retried after a back-off,
+// and left alone after a bounded number of rounds.
+static void mgos_apds9960_irq_group_worker(void *arg) {
+  struct mgos_apds9960_irq_group *group = (struct mgos_apds9960_irq_group *)arg;
+  int64_t irq_us;
+
+  if (!group) {
+    return;
+  }
+  group->scheduled     = false;
+  group->backoff_timer = MGOS_INVALID_TIMER_ID;
+  if (group->destroyed) {
+    free(group);
+    return;
+  }
+  irq_us = group->irq_us;
+
+  for (int pass = 0; pass < APDS9960_IRQ_GROUP_PASSES; pass++) {
+    uint8_t start = group->next;
+
+    for (uint8_t i = 0; i < group->num_sensors; i++) {
+      mgos_apds9960_irq_service(group->sensors[(start + i) % group->num_sensors], irq_us);
+    }
+    if (group->num_sensors > 0) {
+      group->next = (start + 1) % group->num_sensors;
+    }
+
+    if (mgos_gpio_read(group->irq_pin)) {
+      group->rounds = 0;
+      return;
+    }
+    irq_us = mgos_uptime_micros();
+  }
+
+  if (++group->rounds >= APDS9960_IRQ_GROUP_ROUNDS) {
+    LOG(LL_ERROR, ("APDS9960 interrupt line %d held low, waiting for the next edge", group->irq_pin));
+    group->rounds = 0;
+    return;
+  }
+
+  // Still asserted: yield to other tasks and continue later
+  group->irq_us        = irq_us;
+  group->scheduled     = true;
+  group->backoff_timer = mgos_set_timer(APDS9960_IRQ_GROUP_BACKOFF_MS, 0, mgos_apds9960_irq_group_worker, group);
+  if (group->backoff_timer == MGOS_INVALID_TIMER_ID) {
+    LOG(LL_ERROR, ("Could not schedule APDS9960 interrupt worker"));
+    group->scheduled = false;
+  }
+}
+
+struct mgos_apds9960_irq_group *mgos_apds9960_irq_group_create(int irq_pin) {
+  struct mgos_apds9960_irq_group *group;
+
+  if (irq_pin < 0) {
+    return NULL;
+  }
+  group = calloc(1, sizeof(struct mgos_apds9960_irq_group));
+  if (!group) {
+    return NULL;
+  }
+  group->irq_pin = irq_pin;
+
+  mgos_gpio_set_mode(irq_pin, MGOS_GPIO_MODE_INPUT);
+  mgos_gpio_set_pull(irq_pin, MGOS_GPIO_PULL_UP);
+  mgos_gpio_set_int_handler(irq_pin, MGOS_GPIO_INT_EDGE_NEG, mgos_apds9960_irq_group_irq, group);
+  mgos_gpio_enable_int(irq_pin);
+  return group;
+}
+
+void mgos_apds9960_irq_group_destroy(struct mgos_apds9960_irq_group **group) {
+  if (!group || !*group) {
+    return;
+  }
+  mgos_gpio_disable_int((*group)->irq_pin);
+  mgos_gpio_remove_int_handler((*group)->irq_pin, NULL, NULL);
+  for (uint8_t i = 0; i < (*group)->num_sensors; i++) {
+    (*group)->sensors[i]->irq_group = NULL;
+  }
+  (*group)->num_sensors = 0;
+
+  // A worker queued with mgos_invoke_cb() cannot be taken back, it frees the
+  // group instead. One waiting on a back-off timer can.
+  if ((*group)->backoff_timer != MGOS_INVALID_TIMER_ID) {
+    mgos_clear_timer((*group)->backoff_timer);
+    (*group)->scheduled = false;
+  }
+  if ((*group)->scheduled) {
+    (*group)->destroyed = true;
+  } else {
+    free(*group);
+  }
+  *group = NULL;
+}
+
+bool mgos_apds9960_irq_group_add(struct mgos_apds9960_irq_group *group, struct mgos_apds9960 *sensor) {
+  if (!group || !sensor) {
+    return false;
+  }
+  if (sensor->irq_pin >= 0 || sensor->irq_group) {
+    LOG(LL_ERROR, ("APDS9960 at I2C 0x%02x already has an interrupt handler", sensor->i2caddr));
+    return false;
+  }
+  if (group->num_sensors >= APDS9960_IRQ_GROUP_SIZE) {
+    return false;
+  }
+  group->sensors[group->num_sensors++] = sensor;
+  sensor->irq_group = group;
+
+  // The line may already be held low by this sensor
+  if (!mgos_gpio_read(group->irq_pin) && !group->scheduled) {
+    group->irq_us = mgos_uptime_micros();
+    group->rounds = 0;
+    mgos_apds9960_irq_group_schedule(group);
+  }
+  return true;
+}
+
+bool mgos_apds9960_irq_group_remove(struct mgos_apds9960_irq_group *group, struct mgos_apds9960 *sensor) {
+  if (!group || !sensor) {
+    return false;
+  }
+  for (uint8_t i = 0; i < group->num_sensors; i++) {
+    if (group->sensors[i] != sensor) {
+      continue;
+    }
+    memmove(&group->sensors[i], &group->sensors[i + 1], (group->num_sensors - i - 1) * sizeof(group->sensors[0]));
+    group->num_sensors--;
+    if (group->next >= group->num_sensors) {
+      group->next = 0;
+    }
+    sensor->irq_group = NULL;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+#define APDS9960_ENGINES    (APDS9960_AEN | APDS9960_PEN | APDS9960_WEN | APDS9960_GEN)
+
+static const struct {
+  uint8_t enable;   // Engines, PON and interrupt enables are kept as they are
+  uint8_t wtime;
+  bool    wlong;
+  uint8_t ppulse;
+  uint8_t gpulse;
+  uint8_t ldrive;
+  uint8_t gldrive;
+  uint8_t boost;
+  uint8_t gwtime;
+} s_power_profiles[] = {
+  // APDS9960_POWER_PRESENCE: proximity every 270ms, 4 short pulses at 25mA
+  { APDS9960_PEN | APDS9960_WEN, 248, true, 0x43, APDS9960_DEFAULT_GPULSE,
+    APDS9960_LED_DRIVE_25MA, APDS9960_LED_DRIVE_25MA, APDS9960_LED_BOOST_100, APDS9960_DEFAULT_GWTIME },
+  // APDS9960_POWER_BALANCED: proximity and light every 130ms (default ATIME)
+  { APDS9960_PEN | APDS9960_WEN | APDS9960_AEN, APDS9960_DEFAULT_WTIME, false, APDS9960_DEFAULT_PROX_PPULSE, APDS9960_DEFAULT_GPULSE,
+    APDS9960_LED_DRIVE_50MA, APDS9960_LED_DRIVE_50MA, APDS9960_LED_BOOST_100, APDS9960_DEFAULT_GWTIME },
+  // APDS9960_POWER_GESTURE: proximity every 4ms for gesture entry, back to
+  // back gesture datasets
+  { APDS9960_PEN | APDS9960_WEN | APDS9960_GEN, 0xFF, false, APDS9960_DEFAULT_GESTURE_PPULSE, APDS9960_DEFAULT_GPULSE,
+    APDS9960_LED_DRIVE_100MA, APDS9960_LED_DRIVE_100MA, APDS9960_LED_BOOST_150, APDS9960_GWTIME_0MS },
+};
+
+// Supply currents from the datasheet, in uA: LED pulses are accounted
+// separately, at the LED drive current scaled by the boost
+static const uint32_t s_led_ua[]     = { 100000, 50000, 25000, 12500 };
+static const uint16_t s_boost_pct[]  = { 100, 150, 200, 300 };
+static const uint8_t  s_plen_us[]    = { 4, 8, 16, 32 };
+static const uint32_t s_gwtime_us[]  = { 0, 2780, 5560, 8340, 13900, 22240, 30580, 38920 };
+
+#define IDD_ALS_UA     200
+#define IDD_PROX_UA    790
+#define IDD_WAIT_UA    38
+#define IDD_SLEEP_UA   1
+
+// LED on-time within one proximity or gesture conversion, for a
+// PPULSE/GPULSE register value
+static uint32_t mgos_apds9960_power_led_us(uint8_t pulse) {
+  return ((pulse & 0x3F) + 1) * s_plen_us[pulse >> 6];
+}
+
+bool mgos_apds9960_get_power_estimate(struct mgos_apds9960 *sensor, struct mgos_apds9960_power_estimate *est) {
+  struct mgos_apds9960_txn txn;
+  uint8_t  enable, atime, ppulse, control, config2, gconf2, gpulse;
+  uint32_t boost, cycle_us, prox_us = 0, als_us = 0, led_us = 0;
+  uint64_t charge;
+
+  if (!sensor || !est) {
+    return false;
+  }
+
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_read(&txn, APDS9960_ENABLE, &enable);
+  mgos_apds9960_txn_read(&txn, APDS9960_ATIME, &atime);
+  mgos_apds9960_txn_read(&txn, APDS9960_PPULSE, &ppulse);
+  mgos_apds9960_txn_read(&txn, APDS9960_CONTROL, &control);
+  mgos_apds9960_txn_read(&txn, APDS9960_CONFIG2, &config2);
+  mgos_apds9960_txn_read(&txn, APDS9960_GCONF2, &gconf2);
+  mgos_apds9960_txn_read(&txn, APDS9960_GPULSE, &gpulse);
+  if (!mgos_apds9960_txn_commit(&txn) || !mgos_apds9960_get_cycle_time(sensor, &cycle_us)) {
+    return false;
+  }
+  memset(est, 0, sizeof(*est));
+  boost = s_boost_pct[(config2 >> 4) & 0b00000011];
+
+  if (!(enable & APDS9960_PON)) {
+    est->current_ua = IDD_SLEEP_UA;
+    return true;
+  }
+
+  // Whatever of the cycle is neither proximity nor ALS is wait time
+  if (enable & APDS9960_PEN) {
+    prox_us = mgos_apds9960_pulse_time_us(ppulse);
+    led_us  = mgos_apds9960_power_led_us(ppulse);
+  }
+  if (enable & APDS9960_AEN) {
+    als_us = (256 - atime) * 2780;
+  }
+  est->cycle_us = cycle_us;
+  if (est->cycle_us == 0) {
+    est->current_ua = IDD_WAIT_UA;
+    return true;
+  }
+
+  // Charge per cycle in pC (uA x us), averaged over the cycle
+  charge = (uint64_t)IDD_PROX_UA * prox_us + (uint64_t)IDD_WAIT_UA * (cycle_us - prox_us - als_us) + (uint64_t)IDD_ALS_UA * als_us +
+           (uint64_t)s_led_ua[control >> 6] * boost / 100 * led_us;
+  est->current_ua          = (uint32_t)(charge / est->cycle_us);
+  est->sample_rate_millihz = 1000000000 / est->cycle_us;
+
+  // While a gesture is in progress, datasets follow each other at GWTIME
+  if (enable & APDS9960_GEN) {
+    uint32_t gesture_us, gwait_us = s_gwtime_us[gconf2 & 0b00000111];
+
+    gesture_us = mgos_apds9960_pulse_time_us(gpulse);
+    led_us     = mgos_apds9960_power_led_us(gpulse);
+    charge     = (uint64_t)IDD_PROX_UA * gesture_us + (uint64_t)IDD_WAIT_UA * gwait_us +
+                 (uint64_t)s_led_ua[(gconf2 >> 3) & 0b00000011] * boost / 100 * led_us;
+    est->gesture_rate_hz    = 1000000 / (gesture_us + gwait_us);
+    est->gesture_current_ua = (uint32_t)(charge / (gesture_us + gwait_us));
+  }
+  return true;
+}
+
+bool mgos_apds9960_set_power_profile(struct mgos_apds9960 *sensor, enum mgos_apds9960_power_profile profile, struct mgos_apds9960_power_estimate *est) {
+  struct mgos_apds9960_txn txn;
+  uint8_t enable, config1, control, config2, gconf2;
+
+  if (!sensor || profile >= sizeof(s_power_profiles) / sizeof(s_power_profiles[0])) {
+    return false;
+  }
+
+  if (!mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &enable) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_CONFIG1, &config1) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_CONTROL, &control) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_CONFIG2, &config2) ||
+      !mgos_apds9960_reg_read(sensor, APDS9960_GCONF2, &gconf2)) {
+    return false;
+  }
+
+  config1 = (config1 & ~APDS9960_WLONG) | (s_power_profiles[profile].wlong ? APDS9960_WLONG : 0);
+  control = (control & 0b00111111) | (s_power_profiles[profile].ldrive << 6);
+  config2 = (config2 & 0b11001111) | (s_power_profiles[profile].boost << 4);
+  gconf2  = (gconf2 & 0b11100000) | (s_power_profiles[profile].gldrive << 3) | s_power_profiles[profile].gwtime;
+  enable  = (enable & ~APDS9960_ENGINES) | APDS9960_PON | s_power_profiles[profile].enable;
+
+  // Timing and LED settings first, merged into as few bursts as possible,
+  // and the engines only once those are in place
+  mgos_apds9960_txn_init(&txn, sensor);
+  mgos_apds9960_txn_write(&txn, APDS9960_WTIME, s_power_profiles[profile].wtime);
+  mgos_apds9960_txn_write(&txn, APDS9960_CONFIG1, config1);
+  mgos_apds9960_txn_write(&txn, APDS9960_PPULSE, s_power_profiles[profile].ppulse);
+  mgos_apds9960_txn_write(&txn, APDS9960_CONTROL, control);
+  mgos_apds9960_txn_write(&txn, APDS9960_CONFIG2, config2);
+  mgos_apds9960_txn_write(&txn, APDS9960_GCONF2, gconf2);
+  mgos_apds9960_txn_write(&txn, APDS9960_GPULSE, s_power_profiles[profile].gpulse);
+  if (!mgos_apds9960_txn_commit(&txn) || !mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ENABLE, enable)) {
+    return false;
+  }
+
+  if (sensor->sampler) {
+    mgos_apds9960_sampler_resync(sensor->sampler);
+  }
+  return est ? mgos_apds9960_get_power_estimate(sensor, est) : true;
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+struct mgos_apds9960_sampler {
+  struct mgos_apds9960 *       sensors[APDS9960_SAMPLER_SIZE];
+  uint8_t                      num_sensors;
+  uint32_t                     period_ms;    // As requested
+  uint32_t                     interval_ms;  // Rounded up to whole sensor cycles
+  mgos_timer_id                timer;
+  mgos_apds9960_sample_event_t handler;
+  void *                       handler_arg;
+};
+
+// Reads STATUS through PDATA in one burst. AVALID and PVALID in the status
+// tell whether the conversions completed since the previous read; reading the
+// data clears them again.
+static bool mgos_apds9960_sample_read(struct mgos_apds9960 *sensor, struct mgos_apds9960_sample *sample) {
+  uint8_t data[APDS9960_PDATA - APDS9960_STATUS + 1];
+
+  if (mgos_apds9960_wireReadDataBlock(sensor, APDS9960_STATUS, data, sizeof(data)) != sizeof(data)) {
+    return false;
+  }
+  sample->sensor    = sensor;
+  sample->time_us   = mgos_uptime_micros();
+  sample->status    = data[0];
+  sample->proximity = data[APDS9960_PDATA - APDS9960_STATUS];
+  mgos_apds9960_decode_rgbc(&data[APDS9960_CDATAL - APDS9960_STATUS], &sample->rgbc);
+  return true;
+}
+
+// The next conversion completes within one cycle from any point in it
+static bool mgos_apds9960_sample_deadline(struct mgos_apds9960 *sensor, uint8_t valid, int64_t *deadline_us, uint32_t *poll_us) {
+  uint32_t cycle_us;
+  uint8_t  enable;
+
+  if (!mgos_apds9960_get_cycle_time(sensor, &cycle_us) || !mgos_apds9960_reg_read(sensor, APDS9960_ENABLE, &enable)) {
+    return false;
+  }
+  if (!(enable & APDS9960_PON) ||
+      ((valid & APDS9960_STATUS_AVALID) && !(enable & APDS9960_AEN)) ||
+      ((valid & APDS9960_STATUS_PVALID) && !(enable & APDS9960_PEN))) {
+    return false;
+  }
+
+  *deadline_us = mgos_uptime_micros() + cycle_us + cycle_us / 4 + APDS9960_SAMPLE_MARGIN_US;
+  *poll_us     = cycle_us / 16;
+  if (*poll_us < 1000) {
+    *poll_us = 1000;
+  }
+  if (*poll_us > 10000) {
+    *poll_us = 10000;
+  }
+  return true;
+}
+
+bool mgos_apds9960_wait_for_sample(struct mgos_apds9960 *sensor, uint8_t valid, struct mgos_apds9960_sample *sample) {
+  int64_t  deadline_us;
+  uint32_t poll_us;
+
+  if (!sensor || !sample || !valid) {
+    return false;
+  }
+  if (!mgos_apds9960_sample_deadline(sensor, valid, &deadline_us, &poll_us)) {
+    return false;
+  }
+
+  for (;;) {
+    if (mgos_apds9960_sample_read(sensor, sample) && (sample->status & valid) == valid) {
+      return true;
+    }
+    if (mgos_uptime_micros() >= deadline_us) {
+      return false;
+    }
+    mgos_usleep(poll_us);
+  }
+}
+
+static void mgos_apds9960_sample_timer_cb(void *arg) {
+  struct mgos_apds9960 *      sensor = (struct mgos_apds9960 *)arg;
+  struct mgos_apds9960_sample sample;
+  mgos_apds9960_sample_event_t handler;
+  bool ready;
+
+  if (!sensor || !sensor->sample_handler) {
+    return;
+  }
+  ready = mgos_apds9960_sample_read(sensor, &sample) && (sample.status & sensor->sample_valid) == sensor->sample_valid;
+  if (!ready && mgos_uptime_micros() < sensor->sample_deadline_us) {
+    return;
+  }
+  if (!ready) {
+    LOG(LL_WARN, ("No APDS9960 sample at I2C 0x%02x before the deadline", sensor->i2caddr));
+  }
+
+  handler = sensor->sample_handler;
+  mgos_clear_timer(sensor->sample_timer);
+  sensor->sample_timer   = MGOS_INVALID_TIMER_ID;
+  sensor->sample_handler = NULL;
+  handler(ready ? &sample : NULL, sensor->sample_arg);
+}
+
+bool mgos_apds9960_read_sample_async(struct mgos_apds9960 *sensor, uint8_t valid, mgos_apds9960_sample_event_t handler, void *arg) {
+  uint32_t poll_us;
+
+  if (!sensor || !handler || !valid || sensor->sample_handler) {
+    return false;
+  }
+  if (!mgos_apds9960_sample_deadline(sensor, valid, &sensor->sample_deadline_us, &poll_us)) {
+    return false;
+  }
+
+  sensor->sample_valid   = valid;
+  sensor->sample_handler = handler;
+  sensor->sample_arg     = arg;
+  sensor->sample_timer   = mgos_set_timer(poll_us / 1000, MGOS_TIMER_REPEAT, mgos_apds9960_sample_timer_cb, sensor);
+  if (sensor->sample_timer == MGOS_INVALID_TIMER_ID) {
+    sensor->sample_handler = NULL;
+    return false;
+  }
+  return true;
+}
+
+// One burst per sensor, STATUS through PDATA, back to back. Sensors that have
+// not completed a conversion since the previous read are skipped, so that no
+// sample is delivered twice.
+static void mgos_apds9960_sampler_timer_cb(void *arg) {
+  struct mgos_apds9960_sampler *sampler = (struct mgos_apds9960_sampler *)arg;
+  struct mgos_apds9960_sample   samples[APDS9960_SAMPLER_SIZE];
+  uint8_t num = 0;
+
+  if (!sampler) {
+    return;
+  }
+
+  for (uint8_t i = 0; i < sampler->num_sensors; i++) {
+    if (!mgos_apds9960_sample_read(sampler->sensors[i], &samples[num])) {
+      continue;
+    }
+    if (samples[num].status & (APDS9960_STATUS_AVALID | APDS9960_STATUS_PVALID)) {
+      num++;
+    }
+  }
+
+  // Handlers run after the bus work, so they do not stretch the batch
+  for (uint8_t i = 0; i < num; i++) {
+    sampler->handler(&samples[i], sampler->handler_arg);
+  }
+}
+
+// Periods of more than about 71 minutes do not fit 32 bits in usec, so the
+// rounding is done in 64 bits. The timer takes an int.
+static void mgos_apds9960_sampler_restart(struct mgos_apds9960_sampler *sampler) {
+  uint64_t period_us   = (uint64_t)sampler->period_ms * 1000;
+  uint64_t interval_us = period_us;
+
+  for (uint8_t i = 0; i < sampler->num_sensors; i++) {
+    uint32_t cycle_us;
+    uint64_t rounded_us;
+
+    if (!mgos_apds9960_get_cycle_time(sampler->sensors[i], &cycle_us) || cycle_us == 0) {
+      continue;
+    }
+    rounded_us = ((period_us + cycle_us - 1) / cycle_us) * cycle_us;
+    if (rounded_us > interval_us) {
+      interval_us = rounded_us;
+    }
+  }
+  if (interval_us > (uint64_t)INT32_MAX * 1000) {
+    interval_us = (uint64_t)INT32_MAX * 1000;
+  }
+
+  if (sampler->timer != MGOS_INVALID_TIMER_ID) {
+    mgos_clear_timer(sampler->timer);
+    sampler->timer = MGOS_INVALID_TIMER_ID;
+  }
+  sampler->interval_ms = (uint32_t)((interval_us + 999) / 1000);
+  if (sampler->num_sensors > 0) {
+    sampler->timer = mgos_set_timer(sampler->interval_ms, MGOS_TIMER_REPEAT, mgos_apds9960_sampler_timer_cb, sampler);
+  }
+}
+
+struct mgos_apds9960_sampler *mgos_apds9960_sampler_create(uint32_t period_ms, mgos_apds9960_sample_event_t handler, void *arg) {
+  struct mgos_apds9960_sampler *sampler;
+
+  if (period_ms == 0 || !handler) {
+    return NULL;
+  }
+  sampler = calloc(1, sizeof(struct mgos_apds9960_sampler));
+  if (!sampler) {
+    return NULL;
+  }
+  sampler->period_ms   = period_ms;
+  sampler->interval_ms = period_ms;
+  sampler->timer       = MGOS_INVALID_TIMER_ID;
+  sampler->handler     = handler;
+  sampler->handler_arg = arg;
+  return sampler;
+}
+
+void mgos_apds9960_sampler_destroy(struct mgos_apds9960_sampler **sampler) {
+  if (!sampler || !*sampler) {
+    return;
+  }
+  if ((*sampler)->timer != MGOS_INVALID_TIMER_ID) {
+    mgos_clear_timer((*sampler)->timer);
+  }
+  for (uint8_t i = 0; i < (*sampler)->num_sensors; i++) {
+    (*sampler)->sensors[i]->sampler = NULL;
+  }
+
+  free(*sampler);
+  *sampler = NULL;
+}
+
+bool mgos_apds9960_sampler_add(struct mgos_apds9960_sampler *sampler, struct mgos_apds9960 *sensor) {
+  if (!sampler || !sensor) {
+    return false;
+  }
+  if (sensor->sampler) {
+    return sensor->sampler == sampler;
+  }
+  if (sampler->num_sensors >= APDS9960_SAMPLER_SIZE) {
+    return false;
+  }
+  sampler->sensors[sampler->num_sensors++] = sensor;
+  sensor->sampler = sampler;
+  mgos_apds9960_sampler_restart(sampler);
+  return true;
+}
+
+bool mgos_apds9960_sampler_remove(struct mgos_apds9960_sampler *sampler, struct mgos_apds9960 *sensor) {
+  if (!sampler || !sensor) {
+    return false;
+  }
+  for (uint8_t i = 0; i < sampler->num_sensors; i++) {
+    if (sampler->sensors[i] != sensor) {
+      continue;
+    }
+    memmove(&sampler->sensors[i], &sampler->sensors[i + 1], (sampler->num_sensors - i - 1) * sizeof(sampler->sensors[0]));
+    sampler->num_sensors--;
+    sensor->sampler = NULL;
+    mgos_apds9960_sampler_restart(sampler);
+    return true;
+  }
+  return false;
+}
+
+bool mgos_apds9960_sampler_resync(struct mgos_apds9960_sampler *sampler) {
+  if (!sampler) {
+    return false;
+  }
+  mgos_apds9960_sampler_restart(sampler);
+  return true;
+}
+
+uint32_t mgos_apds9960_sampler_get_interval(struct mgos_apds9960_sampler *sampler) {
+  if (!sampler) {
+    return 0;
+  }
+  return sampler->interval_ms;
+}
@@ -0,0 +1,658 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef MGOS_APDS9960_SIM
+#include "mgos_apds9960_internal.h"
+#include "mgos_apds9960_sim.h"
+
+#define SIM_STEP_US         2780   // One ALS integration step / wait step
+#define SIM_BYTE_US         90     // 9 bit times at 100kHz
+#define SIM_START_STOP_US   20
+
+#define SIM_INT_AINT        APDS9960_STATUS_AINT
+#define SIM_INT_PINT        APDS9960_STATUS_PINT
+#define SIM_INT_GINT        APDS9960_STATUS_GINT
+
+enum mgos_apds9960_sim_phase {
+  SIM_IDLE,
+  SIM_PROX,
+  SIM_GESTURE,
+  SIM_WAIT,
+  SIM_ALS,
+  SIM_SLEEP,
+};
+
+struct mgos_apds9960_sim {
+  struct mgos_i2c *                    i2c;
+  uint8_t                              i2caddr;
+  uint8_t                              regs[256];
+  uint8_t                              ptr;
+  bool                                 nack;
+
+  struct mgos_apds9960_sim_input       input;
+  mgos_apds9960_sim_waveform_t         waveform;
+  void *                               waveform_arg;
+
+  enum mgos_apds9960_sim_phase         phase;
+  uint32_t                             phase_remaining_us;
+  uint8_t                              status;
+  uint8_t                              als_pers;
+  uint8_t                              prox_pers;
+  uint8_t                              gesture_exit_pers;
+  bool                                 gmode;
+
+  struct mgos_apds9960_gesture_dataset fifo[APDS9960_GESTURE_FIFO_SIZE];
+  uint8_t                              fifo_head;
+  uint8_t                              fifo_count;
+  bool                                 gfov;
+
+  struct mgos_apds9960_sim_stats       stats;
+};
+
+static struct mgos_apds9960_sim *s_sims[MGOS_APDS9960_SIM_MAX_DEVICES];
+static int64_t s_time_us = 0;
+
+static const uint8_t  s_again[]       = { 1, 4, 16, 64 };
+static const uint16_t s_pulse_acc[]   = { 29, 37, 53, 86 };  // us per pulse, by PPLEN/GPLEN
+static const uint16_t s_gwtime_us[]   = { 0, 2800, 5600, 8400, 14000, 22400, 30800, 39200 };
+
+static struct mgos_apds9960_sim *sim_find(struct mgos_i2c *i2c, uint16_t addr) {
+  for (int i = 0; i < MGOS_APDS9960_SIM_MAX_DEVICES; i++) {
+    if (s_sims[i] && s_sims[i]->i2c == i2c && s_sims[i]->i2caddr == addr) {
+      return s_sims[i];
+    }
+  }
+  return NULL;
+}
+
+static uint8_t sim_gfifoth(struct mgos_apds9960_sim *sim) {
+  static const uint8_t levels[] = { 1, 4, 8, 16 };
+
+  return levels[(sim->regs[APDS9960_GCONF1] >> 6) & 0x03];
+}
+
+static bool sim_gvalid(struct mgos_apds9960_sim *sim) {
+  if (sim->fifo_count == 0) {
+    return false;
+  }
+  return sim->fifo_count >= sim_gfifoth(sim) || !sim->gmode;
+}
+
+static uint8_t sim_status(struct mgos_apds9960_sim *sim) {
+  uint8_t status = sim->status & ~SIM_INT_GINT;
+
+  if (sim_gvalid(sim)) {
+    status |= SIM_INT_GINT;
+  }
+  return status;
+}
+
+static void sim_update_regs(struct mgos_apds9960_sim *sim) {
+  sim->regs[APDS9960_STATUS]  = sim_status(sim);
+  sim->regs[APDS9960_GFLVL]   = sim->fifo_count;
+  sim->regs[APDS9960_GSTATUS] = (sim->gfov ? APDS9960_GFOV : 0) | (sim_gvalid(sim) ? APDS9960_GVALID : 0);
+  sim->regs[APDS9960_GCONF4]  = (sim->regs[APDS9960_GCONF4] & ~0x05) | (sim->gmode ? 0x01 : 0);
+}
+
+bool mgos_apds9960_sim_int_asserted(struct mgos_apds9960_sim *sim) {
+  uint8_t enable, status;
+
+  if (!sim) {
+    return false;
+  }
+  enable = sim->regs[APDS9960_ENABLE];
+  status = sim_status(sim);
+  return ((status & SIM_INT_AINT) && (enable & APSD9960_AIEN)) ||
+         ((status & SIM_INT_PINT) && (enable & APDS9960_PIEN)) ||
+         ((status & SIM_INT_GINT) && (sim->regs[APDS9960_GCONF4] & 0x02)) ||
+         ((status & APDS9960_STATUS_CPSAT) && (sim->regs[APDS9960_CONFIG2] & 0x40)) ||
+         ((status & APDS9960_STATUS_PGSAT) && (sim->regs[APDS9960_CONFIG2] & 0x80));
+}
+
+static void sim_sample_input(struct mgos_apds9960_sim *sim) {
+  if (sim->waveform) {
+    sim->waveform(s_time_us, &sim->input, sim->waveform_arg);
+  }
+}
+
+// Offset registers are sign/magnitude, positive values subtract from the result
+static int sim_offset(uint8_t reg) {
+  return (reg & 0x80) ? -(int)(reg & 0x7F) : (int)(reg & 0x7F);
+}
+
+static uint8_t sim_clamp8(int v) {
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static bool sim_persist(uint8_t *count, uint8_t pers, bool out_of_range) {
+  if (!out_of_range) {
+    *count = 0;
+    return pers == 0;
+  }
+  if (*count < 0xFF) {
+    (*count)++;
+  }
+  return pers == 0 || *count >= pers;
+}
+
+static void sim_prox_complete(struct mgos_apds9960_sim *sim) {
+  uint8_t pmask = sim->regs[APDS9960_CONFIG3] & 0x0F;
+  uint8_t pdata, ppers;
+  int     signal;
+
+  // Each pair sees half of the input and has its own offset; PMASK drops
+  // either pair (D/L: 0x06, U/R: 0x09) entirely.
+  sim_sample_input(sim);
+  signal = 0;
+  if ((pmask & 0x09) != 0x09) {
+    signal += (int)sim->input.proximity / 2 - sim_offset(sim->regs[APDS9960_POFFSET_UR]);
+  }
+  if ((pmask & 0x06) != 0x06) {
+    signal += (int)sim->input.proximity / 2 - sim_offset(sim->regs[APDS9960_POFFSET_DL]);
+  }
+  pdata = sim_clamp8(signal);
+  if (sim->input.proximity == 0xFF) {
+    sim->status |= APDS9960_STATUS_PGSAT;
+  }
+  sim->regs[APDS9960_PDATA] = pdata;
+  sim->status              |= APDS9960_STATUS_PVALID;
+
+  ppers = sim->regs[APDS9960_PERS] >> 4;
+  if (sim_persist(&sim->prox_pers, ppers, pdata < sim->regs[APDS9960_PILT] || pdata > sim->regs[APDS9960_PIHT])) {
+    sim->status |= SIM_INT_PINT;
+  }
+
+  if ((sim->regs[APDS9960_ENABLE] & APDS9960_GEN) && pdata > sim->regs[APDS9960_GPENTH]) {
+    sim->gmode = true;
+  }
+}
+
+static void sim_gesture_complete(struct mgos_apds9960_sim *sim) {
+  struct mgos_apds9960_gesture_dataset d;
+  uint8_t exth = sim->regs[APDS9960_GEXTH];
+  uint8_t expers;
+
+  sim_sample_input(sim);
+  d.up    = sim_clamp8((int)sim->input.gesture.up - sim_offset(sim->regs[APDS9960_GOFFSET_U]));
+  d.down  = sim_clamp8((int)sim->input.gesture.down - sim_offset(sim->regs[APDS9960_GOFFSET_D]));
+  d.left  = sim_clamp8((int)sim->input.gesture.left - sim_offset(sim->regs[APDS9960_GOFFSET_L]));
+  d.right = sim_clamp8((int)sim->input.gesture.right - sim_offset(sim->regs[APDS9960_GOFFSET_R]));
+
+  if (sim->fifo_count < APDS9960_GESTURE_FIFO_SIZE) {
+    sim->fifo[(sim->fifo_head + sim->fifo_count) % APDS9960_GESTURE_FIFO_SIZE] = d;
+    sim->fifo_count++;
+  } else {
+    sim->gfov = true;
+  }
+
+  // Exit when all channels stayed at or below GEXTH for GEXPERS datasets
+  expers = 1 << (sim->regs[APDS9960_GCONF1] & 0x03);
+  if (exth > 0 && sim_persist(&sim->gesture_exit_pers, expers, d.up <= exth && d.down <= exth && d.left <= exth && d.right <= exth)) {
+    sim->gmode             = false;
+    sim->gesture_exit_pers = 0;
+  }
+}
+
+static void sim_als_complete(struct mgos_apds9960_sim *sim) {
+  uint32_t steps = 256 - sim->regs[APDS9960_ATIME];
+  uint32_t full  = steps * 1025 > 65535 ? 65535 : steps * 1025;
+  uint32_t gain  = s_again[sim->regs[APDS9960_CONTROL] & 0x03];
+  const uint16_t *in = &sim->input.clear;
+  uint16_t thresh_lo, thresh_hi, clear;
+  uint8_t  apers;
+
+  sim_sample_input(sim);
+  for (int i = 0; i < 4; i++) {
+    uint32_t counts = in[i] * gain * steps;
+
+    if (counts >= full) {
+      counts = full;
+      if (i == 0) {
+        sim->status |= APDS9960_STATUS_CPSAT;
+      }
+    }
+    sim->regs[APDS9960_CDATAL + 2 * i]     = counts & 0xFF;
+    sim->regs[APDS9960_CDATAL + 2 * i + 1] = counts >> 8;
+  }
+  sim->status |= APDS9960_STATUS_AVALID;
+
+  clear     = sim->regs[APDS9960_CDATAL] | (sim->regs[APDS9960_CDATAH] << 8);
+  thresh_lo = sim->regs[APDS9960_AILTL] | (sim->regs[APDS9960_AILTH] << 8);
+  thresh_hi = sim->regs[APDS9960_AIHTL] | (sim->regs[APDS9960_AIHTH] << 8);
+  apers     = sim->regs[APDS9960_PERS] & 0x0F;
+  if (apers > 3) {
+    apers = 5 * (apers - 3);
+  }
+  if (sim_persist(&sim->als_pers, apers, clear < thresh_lo || clear > thresh_hi)) {
+    sim->status |= SIM_INT_AINT;
+  }
+}
+
+static uint32_t sim_prox_time(struct mgos_apds9960_sim *sim, uint8_t pulse_reg) {
+  uint8_t pulse = sim->regs[pulse_reg];
+
+  return 800 + ((pulse & 0x3F) + 1) * s_pulse_acc[pulse >> 6];
+}
+
+// Pick the phase following `from`, in the datasheet's order: idle, proximity,
+// gesture, wait, ALS and sleep.
+static void sim_next_phase(struct mgos_apds9960_sim *sim, enum mgos_apds9960_sim_phase from) {
+  uint8_t enable = sim->regs[APDS9960_ENABLE];
+
+  if (!(enable & APDS9960_PON) || !(enable & (APDS9960_AEN | APDS9960_PEN | APDS9960_GEN))) {
+    sim->phase              = SIM_IDLE;
+    sim->phase_remaining_us = 0;
+    return;
+  }
+
+  switch (from) {
+  case SIM_IDLE:
+  case SIM_SLEEP:
+    if (enable & (APDS9960_PEN | APDS9960_GEN)) {
+      sim->phase              = SIM_PROX;
+      sim->phase_remaining_us = sim_prox_time(sim, APDS9960_PPULSE);
+      return;
+    }
+  // fall through
+  case SIM_PROX:
+    if ((enable & APDS9960_GEN) && sim->gmode) {
+      sim->phase              = SIM_GESTURE;
+      sim->phase_remaining_us = s_gwtime_us[sim->regs[APDS9960_GCONF2] & 0x07] + sim_prox_time(sim, APDS9960_GPULSE);
+      return;
+    }
+  // fall through
+  case SIM_GESTURE:
+    if ((enable & APDS9960_GEN) && sim->gmode) {
+      sim->phase              = SIM_GESTURE;
+      sim->phase_remaining_us = s_gwtime_us[sim->regs[APDS9960_GCONF2] & 0x07] + sim_prox_time(sim, APDS9960_GPULSE);
+      return;
+    }
+    if (enable & APDS9960_WEN) {
+      sim->phase              = SIM_WAIT;
+      sim->phase_remaining_us = (256 - sim->regs[APDS9960_WTIME]) * SIM_STEP_US * ((sim->regs[APDS9960_CONFIG1] & 0x02) ? 12 : 1);
+      return;
+    }
+  // fall through
+  case SIM_WAIT:
+    if (enable & APDS9960_AEN) {
+      sim->phase              = SIM_ALS;
+      sim->phase_remaining_us = (256 - sim->regs[APDS9960_ATIME]) * SIM_STEP_US;
+      return;
+    }
+  // fall through
+  case SIM_ALS:
+    if ((sim->regs[APDS9960_CONFIG3] & 0x10) && mgos_apds9960_sim_int_asserted(sim)) {
+      sim->phase              = SIM_SLEEP;
+      sim->phase_remaining_us = 0;
+      return;
+    }
+    sim_next_phase(sim, SIM_IDLE);
+    return;
+  }
+}
+
+static void sim_complete_phase(struct mgos_apds9960_sim *sim) {
+  enum mgos_apds9960_sim_phase from = sim->phase;
+
+  switch (from) {
+  case SIM_PROX:
+    sim_prox_complete(sim);
+    break;
+  case SIM_GESTURE:
+    sim_gesture_complete(sim);
+    break;
+  case SIM_ALS:
+    sim_als_complete(sim);
+    break;
+  case SIM_IDLE:
+  case SIM_WAIT:
+    break;
+  case SIM_SLEEP:
+    // Left only by clearing the interrupt, or clearing SAI
+    if ((sim->regs[APDS9960_CONFIG3] & 0x10) && mgos_apds9960_sim_int_asserted(sim)) {
+      return;
+    }
+    break;
+  }
+  sim_next_phase(sim, from);
+}
+
+static void sim_step(struct mgos_apds9960_sim *sim, uint32_t usecs) {
+  while (usecs > 0) {
+    uint32_t step;
+
+    if (sim->phase_remaining_us == 0) {
+      sim_complete_phase(sim);
+      if (sim->phase_remaining_us == 0) {
+        // Idle or asleep, nothing happens until the host intervenes
+        break;
+      }
+    }
+    step                     = usecs < sim->phase_remaining_us ? usecs : sim->phase_remaining_us;
+    sim->phase_remaining_us -= step;
+    usecs                   -= step;
+  }
+  sim_update_regs(sim);
+}
+
+void mgos_apds9960_sim_advance(uint32_t usecs) {
+  // Step in small slices so that devices interleave in time
+  while (usecs > 0) {
+    uint32_t slice = usecs > 1000 ? 1000 : usecs;
+
+    s_time_us += slice;
+    for (int i = 0; i < MGOS_APDS9960_SIM_MAX_DEVICES; i++) {
+      if (s_sims[i]) {
+        sim_step(s_sims[i], slice);
+      }
+    }
+    usecs -= slice;
+  }
+}
+
+int64_t mgos_apds9960_sim_time_us(void) {
+  return s_time_us;
+}
+
+/* Register file access, as seen over I2C */
+
+static void sim_special(struct mgos_apds9960_sim *sim, uint8_t reg) {
+  switch (reg) {
+  case APDS9960_IFORCE:
+    sim->status |= SIM_INT_AINT | SIM_INT_PINT;
+    break;
+  case APDS9960_PICLEAR:
+    sim->status &= ~(SIM_INT_PINT | APDS9960_STATUS_PGSAT);
+    break;
+  case APDS9960_CICLEAR:
+    sim->status &= ~(SIM_INT_AINT | APDS9960_STATUS_CPSAT);
+    break;
+  case APDS9960_AICLEAR:
+    sim->status &= ~(SIM_INT_AINT | SIM_INT_PINT | APDS9960_STATUS_CPSAT | APDS9960_STATUS_PGSAT);
+    break;
+  default:
+    return;
+  }
+  sim_update_regs(sim);
+}
+
+static void sim_write_byte(struct mgos_apds9960_sim *sim, uint8_t val) {
+  uint8_t reg = sim->ptr;
+
+  switch (reg) {
+  case APDS9960_ID:
+  case APDS9960_STATUS:
+  case APDS9960_GFLVL:
+  case APDS9960_GSTATUS:
+    break;
+  case APDS9960_GCONF4:
+    sim->gmode = val & 0x01;
+    if (val & 0x04) {
+      sim->fifo_count = 0;
+      sim->gfov       = false;
+    }
+    sim->regs[reg] = val & ~0x04;
+    break;
+  case APDS9960_ENABLE:
+    sim->regs[reg] = val & 0x7F;
+    if (!(val & APDS9960_PON)) {
+      sim->phase              = SIM_IDLE;
+      sim->phase_remaining_us = 0;
+    }
+    if (!(val & APDS9960_GEN)) {
+      sim->gmode = false;
+    }
+    break;
+  default:
+    if (reg < APDS9960_CDATAL || reg > APDS9960_PDATA) {
+      sim->regs[reg] = val;
+    }
+    break;
+  }
+  sim->ptr++;
+  sim_update_regs(sim);
+}
+
+static uint8_t sim_read_byte(struct mgos_apds9960_sim *sim) {
+  uint8_t reg = sim->ptr;
+  uint8_t val;
+
+  if (reg >= APDS9960_GFIFO_U) {
+    // FIFO reads pop one dataset per U/D/L/R quadruple and wrap to GFIFO_U
+    struct mgos_apds9960_gesture_dataset *d = &sim->fifo[sim->fifo_head];
+
+    val = 0;
+    if (sim->fifo_count > 0) {
+      val = ((uint8_t *)d)[reg - APDS9960_GFIFO_U];
+    }
+    if (reg == APDS9960_GFIFO_R) {
+      if (sim->fifo_count > 0) {
+        sim->fifo_head = (sim->fifo_head + 1) % APDS9960_GESTURE_FIFO_SIZE;
+        sim->fifo_count--;
+        if (sim->fifo_count == 0) {
+          sim->gfov = false;
+        }
+      }
+      sim->ptr = APDS9960_GFIFO_U;
+    } else {
+      sim->ptr++;
+    }
+    sim_update_regs(sim);
+    return val;
+  }
+
+  if (reg >= APDS9960_IFORCE && reg <= APDS9960_AICLEAR) {
+    sim_special(sim, reg);
+  }
+  val = sim->regs[reg];
+  if (reg >= APDS9960_CDATAL && reg <= APDS9960_BDATAH) {
+    sim->status &= ~APDS9960_STATUS_AVALID;
+  } else if (reg == APDS9960_PDATA) {
+    sim->status &= ~APDS9960_STATUS_PVALID;
+  } else if (reg == APDS9960_ID) {
+    val = APDS9960_ID_1;
+  }
+  sim->ptr++;
+  sim_update_regs(sim);
+  return val;
+}
+
+static bool sim_begin(struct mgos_apds9960_sim *sim, size_t wr, size_t rd) {
+  if (!sim || sim->nack) {
+    return false;
+  }
+  sim->stats.transactions++;
+  sim->stats.bytes_written += wr;
+  sim->stats.bytes_read    += rd;
+  sim->stats.bus_time_us   += SIM_START_STOP_US + (1 + wr + rd + (wr && rd ? 1 : 0)) * SIM_BYTE_US;
+  return true;
+}
+
+/* mgos_i2c primitives, routed to the simulated devices */
+
+bool mgos_i2c_write(struct mgos_i2c *conn, uint16_t addr, const void *data, size_t len, bool stop) {
+  struct mgos_apds9960_sim *sim = sim_find(conn, addr);
+  const uint8_t *buf            = (const uint8_t *)data;
+
+  if (!sim_begin(sim, len, 0) || len == 0) {
+    return len == 0 && sim;
+  }
+  sim->ptr = buf[0];
+  if (len == 1) {
+    // Address-only access triggers the special functions
+    sim_special(sim, buf[0]);
+  }
+  for (size_t i = 1; i < len; i++) {
+    sim_write_byte(sim, buf[i]);
+  }
+  (void)stop;
+  return true;
+}
+
+bool mgos_i2c_read(struct mgos_i2c *conn, uint16_t addr, void *data, size_t len, bool stop) {
+  struct mgos_apds9960_sim *sim = sim_find(conn, addr);
+  uint8_t *buf                  = (uint8_t *)data;
+
+  if (!sim_begin(sim, 0, len)) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = sim_read_byte(sim);
+  }
+  (void)stop;
+  return true;
+}
+
+void mgos_i2c_stop(struct mgos_i2c *conn) {
+  (void)conn;
+}
+
+int mgos_i2c_read_reg_b(struct mgos_i2c *conn, uint16_t addr, uint8_t reg) {
+  uint8_t val;
+
+  if (!mgos_i2c_read_reg_n(conn, addr, reg, 1, &val)) {
+    return -1;
+  }
+  return val;
+}
+
+bool mgos_i2c_write_reg_b(struct mgos_i2c *conn, uint16_t addr, uint8_t reg, uint8_t value) {
+  return mgos_i2c_write_reg_n(conn, addr, reg, 1, &value);
+}
+
+bool mgos_i2c_read_reg_n(struct mgos_i2c *conn, uint16_t addr, uint8_t reg, size_t n, uint8_t *buf) {
+  struct mgos_apds9960_sim *sim = sim_find(conn, addr);
+
+  if (!sim_begin(sim, 1, n)) {
+    return false;
+  }
+  sim->ptr = reg;
+  for (size_t i = 0; i < n; i++) {
+    buf[i] = sim_read_byte(sim);
+  }
+  return true;
+}
+
+bool mgos_i2c_write_reg_n(struct mgos_i2c *conn, uint16_t addr, uint8_t reg, size_t n, const uint8_t *buf) {
+  struct mgos_apds9960_sim *sim = sim_find(conn, addr);
+
+  if (!sim_begin(sim, 1 + n, 0)) {
+    return false;
+  }
+  sim->ptr = reg;
+  for (size_t i = 0; i < n; i++) {
+    sim_write_byte(sim, buf[i]);
+  }
+  return true;
+}
+
+/* Simulator control */
+
+struct mgos_apds9960_sim *mgos_apds9960_sim_create(struct mgos_i2c *i2c, uint8_t i2caddr) {
+  struct mgos_apds9960_sim *sim;
+  int slot = -1;
+
+  if (sim_find(i2c, i2caddr)) {
+    return NULL;
+  }
+  for (int i = 0; i < MGOS_APDS9960_SIM_MAX_DEVICES; i++) {
+    if (!s_sims[i]) {
+      slot = i;
+      break;
+    }
+  }
+  if (slot < 0) {
+    return NULL;
+  }
+
+  sim = calloc(1, sizeof(struct mgos_apds9960_sim));
+  if (!sim) {
+    return NULL;
+  }
+  sim->i2c     = i2c;
+  sim->i2caddr = i2caddr;
+
+  // Power-on values
+  sim->regs[APDS9960_ATIME]   = 0xFF;
+  sim->regs[APDS9960_WTIME]   = 0xFF;
+  sim->regs[APDS9960_CONFIG1] = 0x40;
+  sim->regs[APDS9960_PPULSE]  = 0x40;
+  sim->regs[APDS9960_GPULSE]  = 0x40;
+  sim->regs[APDS9960_CONFIG2] = 0x01;
+  sim_update_regs(sim);
+
+  s_sims[slot] = sim;
+  return sim;
+}
+
+void mgos_apds9960_sim_destroy(struct mgos_apds9960_sim **sim) {
+  if (!sim || !*sim) {
+    return;
+  }
+  for (int i = 0; i < MGOS_APDS9960_SIM_MAX_DEVICES; i++) {
+    if (s_sims[i] == *sim) {
+      s_sims[i] = NULL;
+    }
+  }
+  free(*sim);
+  *sim = NULL;
+}
+
+void mgos_apds9960_sim_set_input(struct mgos_apds9960_sim *sim, const struct mgos_apds9960_sim_input *input) {
+  if (!sim || !input) {
+    return;
+  }
+  sim->input    = *input;
+  sim->waveform = NULL;
+}
+
+void mgos_apds9960_sim_set_waveform(struct mgos_apds9960_sim *sim, mgos_apds9960_sim_waveform_t waveform, void *arg) {
+  if (!sim) {
+    return;
+  }
+  sim->waveform     = waveform;
+  sim->waveform_arg = arg;
+}
+
+uint8_t mgos_apds9960_sim_get_reg(struct mgos_apds9960_sim *sim, uint8_t reg) {
+  if (!sim) {
+    return 0;
+  }
+  return sim->regs[reg];
+}
+
+void mgos_apds9960_sim_set_nack(struct mgos_apds9960_sim *sim, bool nack) {
+  if (!sim) {
+    return;
+  }
+  sim->nack = nack;
+}
+
+void mgos_apds9960_sim_get_stats(struct mgos_apds9960_sim *sim, struct mgos_apds9960_sim_stats *stats) {
+  if (!sim || !stats) {
+    return;
+  }
+  *stats = sim->stats;
+}
+
+void mgos_apds9960_sim_reset_stats(struct mgos_apds9960_sim *sim) {
+  if (!sim) {
+    return;
+  }
+  memset(&sim->stats, 0, sizeof(sim->stats));
+}
+
+#endif // MGOS_APDS9960_SIM
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_apds9960_internal.h"
+
+void mgos_apds9960_txn_init(struct mgos_apds9960_txn *txn, struct mgos_apds9960 *sensor) {
+  if (!txn) {
+    return;
+  }
+  txn->sensor   = sensor;
+  txn->num_ops  = 0;
+  txn->overflow = false;
+}
+
+static struct mgos_apds9960_txn_op *mgos_apds9960_txn_add(struct mgos_apds9960_txn *txn, uint8_t reg, bool write) {
+  struct mgos_apds9960_txn_op *op;
+
+  if (!txn) {
+    return NULL;
+  }
+  if (txn->num_ops >= APDS9960_TXN_SIZE) {
+    txn->overflow = true;
+    return NULL;
+  }
+
+  op        = &txn->ops[txn->num_ops++];
+  op->reg   = reg;
+  op->write = write;
+  op->val   = 0;
+  op->dst   = NULL;
+  return op;
+}
+
+bool mgos_apds9960_txn_write(struct mgos_apds9960_txn *txn, uint8_t reg, uint8_t val) {
+  struct mgos_apds9960_txn_op *op = mgos_apds9960_txn_add(txn, reg, true);
+
+  if (!op) {
+    return false;
+  }
+  op->val = val;
+  return true;
+}
+
+// Block accesses are split into one op per register, so they must not run
+// past 0xFF. A burst from GFIFO_U, which wraps within the FIFO, goes to the
+// bus directly instead.
+static bool mgos_apds9960_txn_range(struct mgos_apds9960_txn *txn, uint8_t reg, unsigned int len) {
+  if (!txn) {
+    return false;
+  }
+  if (reg + len > 0x100) {
+    txn->overflow = true;
+    return false;
+  }
+  return true;
+}
+
+bool mgos_apds9960_txn_write_block(struct mgos_apds9960_txn *txn, uint8_t reg, const uint8_t *val, unsigned int len) {
+  if (!val || !mgos_apds9960_txn_range(txn, reg, len)) {
+    return false;
+  }
+  for (unsigned int i = 0; i < len; i++) {
+    if (!mgos_apds9960_txn_write(txn, reg + i, val[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool mgos_apds9960_txn_read(struct mgos_apds9960_txn *txn, uint8_t reg, uint8_t *dst) {
+  struct mgos_apds9960_txn_op *op;
+
+  if (!dst) {
+    return false;
+  }
+  if (!(op = mgos_apds9960_txn_add(txn, reg, false))) {
+    return false;
+  }
+  op->dst = dst;
+  return true;
+}
+
+bool mgos_apds9960_txn_read_block(struct mgos_apds9960_txn *txn, uint8_t reg, uint8_t *dst, unsigned int len) {
+  if (!dst || !mgos_apds9960_txn_range(txn, reg, len)) {
+    return false;
+  }
+  for (unsigned int i = 0; i < len; i++) {
+    if (!mgos_apds9960_txn_read(txn, reg + i, &dst[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Value for a register which is not part of the transaction but lies between
+// two that are. Reserved registers are written as zero, other registers only
+// when their current value is known from the shadow copy. Reading through
+// any of them is free of side effects.
+bool mgos_apds9960_txn_bridge(struct mgos_apds9960 *sensor, uint8_t reg, bool write, uint8_t *val) {
+  if (reg == 0x82 || reg == 0x88 || reg == 0x8A || reg == 0xA8) {
+    *val = 0x00;
+    return true;
+  }
+  if (!write) {
+    return mgos_apds9960_reg_is_shadowed(reg);
+  }
+  return mgos_apds9960_shadow_get(sensor, reg, val);
+}
+
+// Writes sort before reads, each by register. The sort is stable, so of two
+// writes to the same register the later one is the one which ends up on the bus.
+static void mgos_apds9960_txn_sort(struct mgos_apds9960_txn *txn) {
+  for (int i = 1; i < txn->num_ops; i++) {
+    struct mgos_apds9960_txn_op op = txn->ops[i];
+    int key = (op.write ? 0 : 0x100) | op.reg;
+    int j   = i - 1;
+
+    while (j >= 0 && ((txn->ops[j].write ? 0 : 0x100) | txn->ops[j].reg) > key) {
+      txn->ops[j + 1] = txn->ops[j];
+      j--;
+    }
+    txn->ops[j + 1] = op;
+  }
+}
+
+// Extends the transfer starting at ops[i] over as many of the following ops
+// as can be reached through contiguous or bridgeable registers. Returns the
+// index of the first op left out, `*len` is set to the transfer length.
+static int mgos_apds9960_txn_span(struct mgos_apds9960_txn *txn, int i, uint8_t *buf, unsigned int *len) {
+  const struct mgos_apds9960_txn_op *first = &txn->ops[i];
+  int end = first->reg;
+  int j;
+
+  buf[0] = first->val;
+  for (j = i + 1; j < txn->num_ops && txn->ops[j].write == first->write; j++) {
+    const struct mgos_apds9960_txn_op *op = &txn->ops[j];
+    int reg;
+
+    if (op->reg - first->reg >= APDS9960_TXN_MAX_LEN || op->reg - end - 1 > APDS9960_TXN_MAX_GAP) {
+      break;
+    }
+    for (reg = end + 1; reg < op->reg; reg++) {
+      if (!mgos_apds9960_txn_bridge(txn->sensor, reg, first->write, &buf[reg - first->reg])) {
+        break;
+      }
+    }
+    if (reg < op->reg) {
+      break;
+    }
+    buf[op->reg - first->reg] = op->val;
+    end = op->reg;
+  }
+
+  *len = end - first->reg + 1;
+  return j;
+}
+
+// Carries out all collected accesses with as few bus transactions as
+// possible: writes first, then reads, each merged into auto-increment block
+// transfers over contiguous registers. Small gaps are bridged when that can
+// be done without side effects, see mgos_apds9960_txn_bridge(). Reads of
+// registers held in the shadow copy do not touch the bus at all.
+bool mgos_apds9960_txn_commit(struct mgos_apds9960_txn *txn) {
+  uint8_t buf[APDS9960_TXN_MAX_LEN];
+  bool    ok = true;
+
+  if (!txn || !txn->sensor) {
+    return false;
+  }
+  if (txn->overflow) {
+    LOG(LL_ERROR, ("Too many register accesses in one transaction, or past 0xFF"));
+    txn->num_ops  = 0;
+    txn->overflow = false;
+    return false;
+  }
+
+  mgos_apds9960_txn_sort(txn);
+  for (int i = 0; i < txn->num_ops && ok;) {
+    const struct mgos_apds9960_txn_op *first = &txn->ops[i];
+    unsigned int len;
+    int          next;
+
+    if (!first->write && mgos_apds9960_shadow_get(txn->sensor, first->reg, first->dst)) {
+      i++;
+      continue;
+    }
+
+    next = mgos_apds9960_txn_span(txn, i, buf, &len);
+    if (first->write) {
+      ok = len == 1 ? mgos_apds9960_wireWriteDataByte(txn->sensor, first->reg, buf[0])
+                    : mgos_apds9960_wireWriteDataBlock(txn->sensor, first->reg, buf, len);
+    } else {
+      ok = len == 1 ? mgos_apds9960_wireReadDataByte(txn->sensor, first->reg, buf)
+                    : mgos_apds9960_wireReadDataBlock(txn->sensor, first->reg, buf, len) == (int)len;
+      for (int j = i; j < next && ok; j++) {
+        *txn->ops[j].dst = buf[txn->ops[j].reg - first->reg];
+      }
+    }
+    i = next;
+  }
+
+  txn->num_ops = 0;
+  return ok;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host stand-in for the parts of Mongoose OS the driver uses */
+
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mgos_sys_config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum cs_log_level {
+  LL_NONE          = -1,
+  LL_ERROR         = 0,
+  LL_WARN          = 1,
+  LL_INFO          = 2,
+  LL_DEBUG         = 3,
+  LL_VERBOSE_DEBUG = 4,
+};
+
+extern int mgos_host_log_level;
+
+#define LOG(l, x)                                       \
+  do {                                                  \
+    if ((l) <= mgos_host_log_level) {                   \
+      printf("%lld ", (long long)mgos_uptime_micros()); \
+      printf x;                                         \
+      printf("\n");                                     \
+    }                                                   \
+  } while (0)
+
+int64_t mgos_uptime_micros(void);
+double mg_time(void);
+void mgos_usleep(uint32_t usecs);
+void mgos_msleep(uint32_t msecs);
+
+typedef void (*mgos_cb_t)(void *arg);
+bool mgos_invoke_cb(mgos_cb_t cb, void *arg, bool from_isr);
+
+typedef uintptr_t mgos_timer_id;
+typedef void (*timer_callback)(void *param);
+#define MGOS_INVALID_TIMER_ID    0
+#define MGOS_TIMER_REPEAT        1
+mgos_timer_id mgos_set_timer(int msecs, int flags, timer_callback cb, void *cb_arg);
+void mgos_clear_timer(mgos_timer_id id);
+
+#ifdef __cplusplus
+}
+#endif
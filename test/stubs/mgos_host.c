@@ -0,0 +1,275 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+
+#ifndef MGOS_HOST_LOG_LEVEL
+#define MGOS_HOST_LOG_LEVEL    LL_NONE
+#endif
+
+int mgos_host_log_level = MGOS_HOST_LOG_LEVEL;
+
+// Defaults from mos.yml
+struct mgos_config mgos_sys_config = {
+  .apds9960 = {
+    .i2caddr = 0x39,
+    .irq_pin = 2,
+  },
+};
+
+struct mgos_host_gpio {
+  struct mgos_apds9960_sim *sims[MGOS_HOST_GPIO_DEVICES];
+  uint8_t                   num_sims;
+  bool                      forced_low;
+  bool                      level;
+  mgos_gpio_int_handler_f   handler;
+  void *                    handler_arg;
+  bool                      int_enabled;
+};
+
+struct mgos_host_cb {
+  mgos_cb_t cb;
+  void *    arg;
+};
+
+struct mgos_host_timer {
+  timer_callback cb;
+  void *         arg;
+  int            msecs;
+  int            flags;
+  int64_t        due_us;
+};
+
+static struct mgos_host_gpio  s_gpio[MGOS_HOST_GPIO_PINS];
+static struct mgos_host_cb    s_cbs[MGOS_HOST_CALLBACKS];
+static int                    s_num_cbs      = 0;
+static uint32_t               s_cbs_run      = 0;
+static struct mgos_host_timer s_timers[MGOS_HOST_TIMERS];
+static uint32_t               s_config_saves = 0;
+
+int64_t mgos_uptime_micros(void) {
+  return mgos_apds9960_sim_time_us();
+}
+
+double mg_time(void) {
+  return mgos_apds9960_sim_time_us() / 1e6;
+}
+
+// Busy waits: simulated time moves on, but nothing else runs meanwhile
+void mgos_usleep(uint32_t usecs) {
+  mgos_apds9960_sim_advance(usecs);
+}
+
+void mgos_msleep(uint32_t msecs) {
+  mgos_apds9960_sim_advance(msecs * 1000);
+}
+
+bool mgos_invoke_cb(mgos_cb_t cb, void *arg, bool from_isr) {
+  if (s_num_cbs >= MGOS_HOST_CALLBACKS) {
+    return false;
+  }
+  s_cbs[s_num_cbs].cb    = cb;
+  s_cbs[s_num_cbs++].arg = arg;
+  (void)from_isr;
+  return true;
+}
+
+mgos_timer_id mgos_set_timer(int msecs, int flags, timer_callback cb, void *cb_arg) {
+  for (int i = 0; i < MGOS_HOST_TIMERS; i++) {
+    if (!s_timers[i].cb) {
+      s_timers[i].cb     = cb;
+      s_timers[i].arg    = cb_arg;
+      s_timers[i].msecs  = msecs;
+      s_timers[i].flags  = flags;
+      s_timers[i].due_us = mgos_uptime_micros() + msecs * 1000LL;
+      return i + 1;
+    }
+  }
+  return MGOS_INVALID_TIMER_ID;
+}
+
+void mgos_clear_timer(mgos_timer_id id) {
+  if (id == MGOS_INVALID_TIMER_ID || id > MGOS_HOST_TIMERS) {
+    return;
+  }
+  s_timers[id - 1].cb = NULL;
+}
+
+bool save_cfg(const struct mgos_config *cfg, char **msg) {
+  s_config_saves++;
+  (void)cfg;
+  (void)msg;
+  return true;
+}
+
+static struct mgos_host_gpio *mgos_host_gpio(int pin) {
+  if (pin < 0 || pin >= MGOS_HOST_GPIO_PINS) {
+    fprintf(stderr, "GPIO %d out of range\n", pin);
+    abort();
+  }
+  return &s_gpio[pin];
+}
+
+// Open-drain line with a pull-up: low while any attached device drives it
+static bool mgos_host_gpio_level(int pin) {
+  struct mgos_host_gpio *gpio = mgos_host_gpio(pin);
+
+  if (gpio->forced_low) {
+    return false;
+  }
+  for (uint8_t i = 0; i < gpio->num_sims; i++) {
+    if (mgos_apds9960_sim_int_asserted(gpio->sims[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool mgos_gpio_set_mode(int pin, enum mgos_gpio_mode mode) {
+  mgos_host_gpio(pin)->level = mgos_host_gpio_level(pin);
+  (void)mode;
+  return true;
+}
+
+bool mgos_gpio_set_pull(int pin, enum mgos_gpio_pull_type pull) {
+  (void)pin;
+  (void)pull;
+  return true;
+}
+
+// Only falling edges are delivered, which is all the driver asks for
+bool mgos_gpio_set_int_handler(int pin, enum mgos_gpio_int_mode mode, mgos_gpio_int_handler_f cb, void *arg) {
+  struct mgos_host_gpio *gpio = mgos_host_gpio(pin);
+
+  if (mode != MGOS_GPIO_INT_EDGE_NEG) {
+    return false;
+  }
+  gpio->handler     = cb;
+  gpio->handler_arg = arg;
+  gpio->level       = mgos_host_gpio_level(pin);
+  return true;
+}
+
+bool mgos_gpio_enable_int(int pin) {
+  mgos_host_gpio(pin)->int_enabled = true;
+  return true;
+}
+
+bool mgos_gpio_disable_int(int pin) {
+  mgos_host_gpio(pin)->int_enabled = false;
+  return true;
+}
+
+void mgos_gpio_remove_int_handler(int pin, mgos_gpio_int_handler_f *old_cb, void **old_arg) {
+  struct mgos_host_gpio *gpio = mgos_host_gpio(pin);
+
+  if (old_cb) {
+    *old_cb = gpio->handler;
+  }
+  if (old_arg) {
+    *old_arg = gpio->handler_arg;
+  }
+  gpio->handler     = NULL;
+  gpio->handler_arg = NULL;
+}
+
+bool mgos_gpio_read(int pin) {
+  return mgos_host_gpio_level(pin);
+}
+
+void mgos_host_gpio_attach(int pin, struct mgos_apds9960_sim *sim) {
+  struct mgos_host_gpio *gpio = mgos_host_gpio(pin);
+
+  if (gpio->num_sims < MGOS_HOST_GPIO_DEVICES) {
+    gpio->sims[gpio->num_sims++] = sim;
+  }
+}
+
+void mgos_host_gpio_detach(int pin) {
+  struct mgos_host_gpio *gpio = mgos_host_gpio(pin);
+
+  gpio->num_sims   = 0;
+  gpio->forced_low = false;
+  gpio->level      = true;
+}
+
+void mgos_host_gpio_force_low(int pin, bool low) {
+  mgos_host_gpio(pin)->forced_low = low;
+}
+
+// Callbacks queued meanwhile wait for the next call, as they would for the
+// next turn of the event loop
+void mgos_host_run_callbacks(void) {
+  int n = s_num_cbs;
+
+  while (n-- > 0 && s_num_cbs > 0) {
+    struct mgos_host_cb cb = s_cbs[0];
+
+    memmove(&s_cbs[0], &s_cbs[1], --s_num_cbs * sizeof(s_cbs[0]));
+    s_cbs_run++;
+    cb.cb(cb.arg);
+  }
+}
+
+void mgos_host_run_gpio(void) {
+  for (int pin = 0; pin < MGOS_HOST_GPIO_PINS; pin++) {
+    struct mgos_host_gpio *gpio = &s_gpio[pin];
+    bool level = mgos_host_gpio_level(pin);
+
+    if (gpio->level && !level && gpio->handler && gpio->int_enabled) {
+      gpio->handler(pin, gpio->handler_arg);
+    }
+    gpio->level = level;
+  }
+}
+
+static void mgos_host_run_timers(void) {
+  for (int i = 0; i < MGOS_HOST_TIMERS; i++) {
+    struct mgos_host_timer timer = s_timers[i];
+
+    if (!timer.cb || timer.due_us > mgos_uptime_micros()) {
+      continue;
+    }
+    if (timer.flags & MGOS_TIMER_REPEAT) {
+      s_timers[i].due_us += timer.msecs * 1000LL;
+    } else {
+      s_timers[i].cb = NULL;
+    }
+    timer.cb(timer.arg);
+  }
+}
+
+void mgos_host_run(uint32_t usecs) {
+  for (uint32_t t = 0; t < usecs; t += MGOS_HOST_TICK_US) {
+    mgos_apds9960_sim_advance(MGOS_HOST_TICK_US);
+    mgos_host_run_gpio();
+    mgos_host_run_callbacks();
+    mgos_host_run_timers();
+    mgos_host_run_callbacks();
+  }
+}
+
+uint32_t mgos_host_callbacks_run(void) {
+  return s_cbs_run;
+}
+
+void mgos_host_reset_counters(void) {
+  s_cbs_run = 0;
+}
+
+uint32_t mgos_host_config_saves(void) {
+  return s_config_saves;
+}
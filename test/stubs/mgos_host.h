@@ -0,0 +1,78 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host runtime for the tests: simulated time is the simulator's, callbacks
+ * passed to mgos_invoke_cb() and timers run from mgos_host_run(), and GPIO
+ * inputs follow the INT outputs of the simulated devices attached to them.
+ */
+
+#pragma once
+#include "mgos.h"
+#include "mgos_gpio.h"
+#include "mgos_apds9960_sim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MGOS_HOST_GPIO_PINS        16
+#define MGOS_HOST_GPIO_DEVICES     8
+#define MGOS_HOST_CALLBACKS        64
+#define MGOS_HOST_TIMERS           32
+#define MGOS_HOST_TICK_US          1000
+
+/* Wires the open-drain INT output of a simulated device to a GPIO input */
+void mgos_host_gpio_attach(int pin, struct mgos_apds9960_sim *sim);
+/* Releases a GPIO input from all devices, before they are destroyed */
+void mgos_host_gpio_detach(int pin);
+/* Holds a GPIO input low, as a stuck line or an unknown device would */
+void mgos_host_gpio_force_low(int pin, bool low);
+
+/* Delivers GPIO edges, without running the callbacks they queue */
+void mgos_host_run_gpio(void);
+/* Runs the callbacks pending so far, without moving time */
+void mgos_host_run_callbacks(void);
+/* Moves time forward in ticks: GPIO edges, callbacks, then due timers */
+void mgos_host_run(uint32_t usecs);
+/* Callbacks run by mgos_invoke_cb() since the last reset */
+uint32_t mgos_host_callbacks_run(void);
+void mgos_host_reset_counters(void);
+/* Calls to save_cfg() */
+uint32_t mgos_host_config_saves(void);
+
+#define CHECK(cond)                                                     \
+  do {                                                                  \
+    if (!(cond)) {                                                      \
+      fprintf(stderr, "%s:%d: CHECK(%s) failed\n",                     \
+              __FILE__, __LINE__, #cond);                               \
+      exit(1);                                                          \
+    }                                                                   \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                  \
+  do {                                                                  \
+    long long _a = (long long)(a), _b = (long long)(b);                 \
+    if (_a != _b) {                                                     \
+      fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n", \
+              __FILE__, __LINE__, #a, #b, _a, _b);                      \
+      exit(1);                                                          \
+    }                                                                   \
+  } while (0)
+
+#ifdef __cplusplus
+}
+#endif
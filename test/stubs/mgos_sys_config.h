@@ -0,0 +1,72 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* The apds9960 section of mos.yml, as the build would generate it */
+
+#pragma once
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct mgos_config_apds9960_calib {
+  bool enable;
+  int  poffset_ur;
+  int  poffset_dl;
+  int  goffset_u;
+  int  goffset_d;
+  int  goffset_l;
+  int  goffset_r;
+};
+
+struct mgos_config_apds9960 {
+  int                               i2caddr;
+  int                               irq_pin;
+  struct mgos_config_apds9960_calib calib;
+};
+
+struct mgos_config {
+  struct mgos_config_apds9960 apds9960;
+};
+
+extern struct mgos_config mgos_sys_config;
+
+bool save_cfg(const struct mgos_config *cfg, char **msg);
+
+#define MGOS_HOST_CONFIG(name, type, field)                                    \
+  static inline type mgos_sys_config_get_apds9960_##name(void) {               \
+    return mgos_sys_config.apds9960.field;                                     \
+  }                                                                            \
+  static inline void mgos_sys_config_set_apds9960_##name(type v) {             \
+    mgos_sys_config.apds9960.field = v;                                        \
+  }
+
+MGOS_HOST_CONFIG(i2caddr, int, i2caddr)
+MGOS_HOST_CONFIG(irq_pin, int, irq_pin)
+MGOS_HOST_CONFIG(calib_enable, bool, calib.enable)
+MGOS_HOST_CONFIG(calib_poffset_ur, int, calib.poffset_ur)
+MGOS_HOST_CONFIG(calib_poffset_dl, int, calib.poffset_dl)
+MGOS_HOST_CONFIG(calib_goffset_u, int, calib.goffset_u)
+MGOS_HOST_CONFIG(calib_goffset_d, int, calib.goffset_d)
+MGOS_HOST_CONFIG(calib_goffset_l, int, calib.goffset_l)
+MGOS_HOST_CONFIG(calib_goffset_r, int, calib.goffset_r)
+
+#undef MGOS_HOST_CONFIG
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS        ((struct mgos_i2c *)0x1)
+#define IRQ_PIN    6
+
+// Bright light makes auto-ranging step down. The conversion after the range
+// change is reported as not valid, which is distinct from a bus error.
+static void test_autorange(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960 *sensor  = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  struct mgos_apds9960_sim_input input = { 0 };
+  struct mgos_apds9960_light light;
+  uint32_t mlux;
+  int      valid = 0, settling = 0;
+
+  CHECK(mgos_apds9960_enable_light_sensor(sensor));
+  CHECK(mgos_apds9960_set_light_autorange(sensor, true));
+  input.clear = 3000;
+  mgos_apds9960_sim_set_input(sim, &input);
+
+  for (int i = 0; i < 10; i++) {
+    mgos_host_run(300000);
+    CHECK(mgos_apds9960_read_light_normalized(sensor, &light));
+    if (light.valid) {
+      valid++;
+    } else {
+      settling++;
+      CHECK(!mgos_apds9960_light_to_lux(sensor, &light, &mlux, NULL));
+    }
+  }
+  CHECK(settling > 0);
+  CHECK(valid > 0);
+  CHECK(light.valid);
+  CHECK(light.gain != APDS9960_DEFAULT_AGAIN || light.atime != APDS9960_DEFAULT_ATIME);
+
+  mgos_apds9960_sim_set_nack(sim, true);
+  CHECK(!mgos_apds9960_read_light_normalized(sensor, &light));
+  CHECK(!light.valid);
+  mgos_apds9960_sim_set_nack(sim, false);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static int      s_light_events      = 0;
+static uint16_t s_light_clear       = 0;
+static int      s_saturation_events = 0;
+
+static void light(uint16_t clear, uint16_t red, uint16_t green, uint16_t blue) {
+  s_light_events++;
+  s_light_clear = clear;
+  (void)red;
+  (void)green;
+  (void)blue;
+}
+
+static void saturation(uint8_t status) {
+  s_saturation_events++;
+  (void)status;
+}
+
+// A saturated conversion is not passed to the light change handler, but the
+// window still moves to it, so that the next change is reported again
+static void test_light_change_saturated(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960 *sensor;
+  struct mgos_apds9960_sim_input input = { 0 };
+  uint16_t low, high, full = (256 - APDS9960_DEFAULT_ATIME) * 1025;
+
+  mgos_host_gpio_attach(IRQ_PIN, sim);
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, IRQ_PIN);
+  CHECK(sensor != NULL);
+  CHECK(mgos_apds9960_set_callback_saturation(sensor, APDS9960_STATUS_CPSAT, false, saturation));
+  CHECK(mgos_apds9960_set_callback_light_change(sensor, 100, 0, light));
+
+  input.clear = 1000;
+  mgos_apds9960_sim_set_input(sim, &input);
+  mgos_host_run(300000);
+  CHECK(s_saturation_events > 0);
+  CHECK_EQ(s_light_events, 0);
+  low  = mgos_apds9960_sim_get_reg(sim, APDS9960_AILTL) | (mgos_apds9960_sim_get_reg(sim, APDS9960_AILTH) << 8);
+  high = mgos_apds9960_sim_get_reg(sim, APDS9960_AIHTL) | (mgos_apds9960_sim_get_reg(sim, APDS9960_AIHTH) << 8);
+  CHECK(low <= full && full <= high);
+
+  input.clear = 10;
+  mgos_apds9960_sim_set_input(sim, &input);
+  mgos_host_run(300000);
+  CHECK(s_light_events > 0);
+  CHECK(s_light_clear < full);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_host_gpio_detach(IRQ_PIN);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static bool lux_for(struct mgos_apds9960_sim *sim, struct mgos_apds9960 *sensor, uint16_t c, uint16_t r, uint16_t g, uint16_t b,
+                    uint32_t *mlux, uint16_t *cct) {
+  struct mgos_apds9960_sim_input input = { 0 };
+
+  input.clear = c;
+  input.red   = r;
+  input.green = g;
+  input.blue  = b;
+  mgos_apds9960_sim_set_input(sim, &input);
+  mgos_apds9960_sim_advance(250000);
+  return mgos_apds9960_read_lux(sensor, mlux, cct);
+}
+
+// DN40 with the default coefficients, at 4x gain and 37 steps (148 counts
+// per unit of input). Expected values worked out by hand from the formula.
+static void test_lux(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960 *sensor  = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  uint32_t mlux;
+  uint16_t cct;
+
+  CHECK(mgos_apds9960_enable_light_sensor(sensor));
+
+  // IR = (R + G + B - C) / 2 = 740 counts is taken off each channel
+  CHECK(lux_for(sim, sensor, 100, 40, 40, 30, &mlux, &cct));
+  CHECK_EQ(mlux, 3195899);
+  CHECK_EQ(cct, 4112);
+  CHECK(lux_for(sim, sensor, 100, 40, 40, 30, NULL, &cct));
+  CHECK(lux_for(sim, sensor, 100, 40, 40, 30, &mlux, NULL));
+
+  // Without red, the colour temperature is unknown
+  CHECK(lux_for(sim, sensor, 100, 0, 60, 40, &mlux, &cct));
+  CHECK_EQ(mlux, 4710215);
+  CHECK_EQ(cct, 0);
+
+  // Strongly blue light: 3810 x B/R + 1391 = 382391K is capped rather than
+  // wrapped to 54711K
+  CHECK(lux_for(sim, sensor, 111, 1, 10, 100, &mlux, &cct));
+  CHECK_EQ(cct, 0xFFFF);
+  CHECK_EQ(mlux, 0);
+
+  // Darkness
+  CHECK(lux_for(sim, sensor, 0, 0, 0, 0, &mlux, &cct));
+  CHECK_EQ(mlux, 0);
+  CHECK_EQ(cct, 0);
+
+  // A saturated clear channel would read as darkness, and fails instead
+  CHECK(!lux_for(sim, sensor, 1000, 400, 400, 300, &mlux, &cct));
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+int main(void) {
+  test_autorange();
+  test_lux();
+  test_light_change_saturated();
+  return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS    ((struct mgos_i2c *)0x1)
+
+static struct mgos_apds9960_sim *s_sim;
+static struct mgos_apds9960 *    s_sensor;
+
+struct done_log {
+  uint8_t regs[APDS9960_ASYNC_QUEUE_SIZE];
+  uint8_t data[APDS9960_ASYNC_QUEUE_SIZE][2];
+  int     num;
+  int     failed;
+};
+
+static void done(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *data, uint8_t len, bool ok, void *arg) {
+  struct done_log *log = (struct done_log *)arg;
+
+  log->regs[log->num] = reg;
+  memcpy(log->data[log->num], data, len < 2 ? len : 2);
+  log->num++;
+  if (!ok) {
+    log->failed++;
+  }
+  (void)sensor;
+}
+
+static uint32_t transactions(void) {
+  struct mgos_apds9960_i2c_stats stats;
+
+  mgos_apds9960_get_i2c_stats(s_sensor, &stats);
+  mgos_apds9960_reset_i2c_stats(s_sensor);
+  return stats.transactions;
+}
+
+// Nothing happens until the event loop runs; then adjacent ops share one
+// transfer and complete in submission order
+static void test_coalesce(void) {
+  struct done_log log = { 0 };
+  uint8_t lo[2] = { 0x10, 0x00 }, hi[2] = { 0x20, 0x01 };
+
+  mgos_apds9960_shadow_invalidate(s_sensor);
+  transactions();
+  CHECK(mgos_apds9960_async_write(s_sensor, APDS9960_AILTL, lo, 2, done, &log));
+  CHECK(mgos_apds9960_async_write(s_sensor, APDS9960_AIHTL, hi, 2, done, &log));
+  CHECK(mgos_apds9960_async_read(s_sensor, APDS9960_PILT, 1, done, &log));
+  CHECK(mgos_apds9960_async_read(s_sensor, APDS9960_PIHT, 1, done, &log));
+  CHECK(mgos_apds9960_async_read(s_sensor, APDS9960_ID, 1, done, &log));
+  CHECK_EQ(transactions(), 0);
+  CHECK_EQ(log.num, 0);
+
+  mgos_host_run_callbacks();
+  CHECK_EQ(log.num, 5);
+  CHECK_EQ(log.failed, 0);
+  CHECK_EQ(log.regs[0], APDS9960_AILTL);
+  CHECK_EQ(log.regs[4], APDS9960_ID);
+  CHECK_EQ(log.data[4][0], APDS9960_ID_1);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, APDS9960_AIHTH), 0x01);
+
+  // AILTL..AIHTH in one write, PILT..PIHT in one read over the reserved
+  // register, and ID on its own
+  CHECK_EQ(transactions(), 3);
+}
+
+// A long queue is worked off a few transfers per event loop turn
+static void test_yield(void) {
+  struct done_log log = { 0 };
+
+  // Repeated reads of one register cannot be merged
+  for (int i = 0; i < APDS9960_ASYNC_QUEUE_SIZE; i++) {
+    CHECK(mgos_apds9960_async_read(s_sensor, APDS9960_ID, 1, done, &log));
+  }
+  CHECK(!mgos_apds9960_async_read(s_sensor, APDS9960_ID, 1, done, &log));
+
+  mgos_host_run_callbacks();
+  CHECK_EQ(log.num, APDS9960_ASYNC_BATCH);
+  mgos_host_reset_counters();
+  mgos_host_run(10000);
+  CHECK_EQ(log.num, APDS9960_ASYNC_QUEUE_SIZE);
+  CHECK_EQ(mgos_host_callbacks_run(), APDS9960_ASYNC_QUEUE_SIZE / APDS9960_ASYNC_BATCH - 1);
+}
+
+static void fifo_done(struct mgos_apds9960 *sensor, uint8_t reg, const uint8_t *data, uint8_t len, bool ok, void *arg) {
+  memcpy(arg, data, len);
+  CHECK(ok);
+  (void)sensor;
+  (void)reg;
+}
+
+// A read from GFIFO_U goes to the device as one burst, which wraps within
+// the FIFO and pops a dataset per 4 bytes
+static void test_fifo_drain(void) {
+  struct mgos_apds9960_sim_input input = { 0 };
+  struct done_log log = { 0 };
+  uint8_t data[12], level;
+
+  input.proximity     = 200;
+  input.gesture.up    = 100;
+  input.gesture.down  = 110;
+  input.gesture.left  = 120;
+  input.gesture.right = 130;
+  mgos_apds9960_sim_set_input(s_sim, &input);
+  CHECK(mgos_apds9960_enable_gesture_sensor(s_sensor));
+  mgos_apds9960_sim_advance(100000);
+  level = mgos_apds9960_sim_get_reg(s_sim, APDS9960_GFLVL);
+  CHECK(level > 3);
+
+  // Reads around it are not merged into the burst
+  CHECK(mgos_apds9960_async_read(s_sensor, APDS9960_GCONF4, 1, done, &log));
+  CHECK(mgos_apds9960_async_read(s_sensor, APDS9960_GFIFO_U, sizeof(data), fifo_done, data));
+  CHECK(mgos_apds9960_async_read(s_sensor, APDS9960_GFIFO_U, 4, done, &log));
+  transactions();
+  mgos_apds9960_async_flush();
+  CHECK_EQ(transactions(), 3);
+  for (size_t i = 0; i < sizeof(data); i += 4) {
+    CHECK_EQ(data[i], 100);
+    CHECK_EQ(data[i + 1], 110);
+    CHECK_EQ(data[i + 2], 120);
+    CHECK_EQ(data[i + 3], 130);
+  }
+  CHECK_EQ(log.data[1][0], 100);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, APDS9960_GFLVL), level - 4);
+
+  // Other ranges may not run past 0xFF
+  CHECK(!mgos_apds9960_async_read(s_sensor, APDS9960_GFIFO_U - 1, 8, done, &log));
+  CHECK(!mgos_apds9960_async_write(s_sensor, APDS9960_GFIFO_U, data, 8, done, &log));
+
+  CHECK(mgos_apds9960_disable_gesture_sensor(s_sensor));
+  memset(&input, 0, sizeof(input));
+  mgos_apds9960_sim_set_input(s_sim, &input);
+}
+
+static void test_flush_and_errors(void) {
+  struct done_log log = { 0 };
+  uint8_t val = 0x42;
+
+  mgos_apds9960_sim_set_nack(s_sim, true);
+  CHECK(mgos_apds9960_async_write(s_sensor, APDS9960_PILT, &val, 1, done, &log));
+  mgos_apds9960_async_flush();
+  mgos_apds9960_sim_set_nack(s_sim, false);
+  CHECK_EQ(log.num, 1);
+  CHECK_EQ(log.failed, 1);
+
+  // Whatever was still queued for a destroyed sensor is dropped silently
+  CHECK(mgos_apds9960_async_write(s_sensor, APDS9960_PILT, &val, 1, done, &log));
+  mgos_apds9960_destroy(&s_sensor);
+  mgos_host_run(10000);
+  CHECK_EQ(log.num, 1);
+}
+
+int main(void) {
+  s_sim    = mgos_apds9960_sim_create(BUS, 0x39);
+  s_sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  CHECK(s_sensor != NULL);
+
+  test_coalesce();
+  test_yield();
+  test_fifo_drain();
+  test_flush_and_errors();
+
+  mgos_apds9960_sim_destroy(&s_sim);
+  return 0;
+}
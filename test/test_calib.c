@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS    ((struct mgos_i2c *)0x1)
+
+// A cover reflecting 60 counts of proximity, 30 into each photodiode pair,
+// and uneven gesture crosstalk. The search settles on the smallest offset
+// leaving at most APDS9960_CALIB_TARGET counts, in sign/magnitude encoding:
+// 30 - 28 = 2, 20 - 18, 40 - 38, 5 - 3, and 0 - (-2) for the dark channel.
+static void test_calibrate(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960_sim_input input = { 0 };
+  struct mgos_apds9960_calibration cal, stored;
+  struct mgos_apds9960 *sensor;
+  uint32_t saves;
+
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  CHECK(sensor != NULL);
+  CHECK(mgos_apds9960_enable_light_sensor(sensor));
+  input.proximity     = 60;
+  input.gesture.up    = 20;
+  input.gesture.down  = 40;
+  input.gesture.left  = 5;
+  input.gesture.right = 0;
+  mgos_apds9960_sim_set_input(sim, &input);
+
+  CHECK(mgos_apds9960_calibrate(sensor, &cal));
+  CHECK_EQ(cal.poffset_ur, 28);
+  CHECK_EQ(cal.poffset_dl, 28);
+  CHECK_EQ(cal.goffset_u, 18);
+  CHECK_EQ(cal.goffset_d, 38);
+  CHECK_EQ(cal.goffset_l, 3);
+  CHECK_EQ(cal.goffset_r, 0x82);
+
+  // The offsets are left in the device, the rest as it was
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_POFFSET_UR), 28);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_POFFSET_DL), 28);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GOFFSET_U), 18);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GOFFSET_D), 38);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GOFFSET_L), 3);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GOFFSET_R), 0x82);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_ENABLE), APDS9960_PON | APDS9960_AEN);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GEXTH), APDS9960_DEFAULT_GEXTH);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_CONFIG3), APDS9960_DEFAULT_CONFIG3);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GCONF4) & APDS9960_GMODE, 0);
+
+  // With the offsets applied, the proximity reading drops to the residual
+  CHECK(mgos_apds9960_enable_proximity_sensor(sensor));
+  mgos_apds9960_sim_advance(300000);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PDATA), 2 * APDS9960_CALIB_TARGET);
+
+  // Saving writes the config section once
+  saves = mgos_host_config_saves();
+  CHECK(mgos_apds9960_save_calibration(&cal));
+  CHECK_EQ(mgos_host_config_saves(), saves + 1);
+  CHECK(mgos_sys_config_get_apds9960_calib_enable());
+  CHECK_EQ(mgos_sys_config_get_apds9960_calib_poffset_ur(), 28);
+  CHECK_EQ(mgos_sys_config_get_apds9960_calib_goffset_d(), 38);
+  CHECK_EQ(mgos_sys_config_get_apds9960_calib_goffset_r(), 0x82);
+  CHECK(mgos_apds9960_load_calibration(&stored));
+  CHECK(memcmp(&stored, &cal, sizeof(cal)) == 0);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+// A device that stops answering fails the calibration
+static void test_calibrate_failure(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960_calibration cal;
+  struct mgos_apds9960 *sensor;
+
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  CHECK(sensor != NULL);
+  mgos_apds9960_sim_set_nack(sim, true);
+  CHECK(!mgos_apds9960_calibrate(sensor, &cal));
+  mgos_apds9960_sim_set_nack(sim, false);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+int main(void) {
+  test_calibrate();
+  test_calibrate_failure();
+  return 0;
+}
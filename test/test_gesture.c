@@ -0,0 +1,163 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS        ((struct mgos_i2c *)0x1)
+#define IRQ_PIN    4
+
+static struct mgos_apds9960_gesture_cursor s_cursor;
+static uint32_t s_datasets   = 0;
+static uint32_t s_mismatches = 0;
+static uint32_t s_events     = 0;
+
+// A hand held over the sensor for 200ms, with each photodiode seeing a
+// distinct level so that datasets can be checked for byte order
+static void hand(int64_t time_us, struct mgos_apds9960_sim_input *input, void *arg) {
+  memset(input, 0, sizeof(*input));
+  if (time_us >= 100000 && time_us < 300000) {
+    input->proximity     = 200;
+    input->gesture.up    = 100;
+    input->gesture.down  = 110;
+    input->gesture.left  = 120;
+    input->gesture.right = 130;
+  }
+  (void)arg;
+}
+
+static void stream(struct mgos_apds9960 *sensor) {
+  const struct mgos_apds9960_gesture_dataset *data;
+  size_t n;
+
+  s_events++;
+  while ((n = mgos_apds9960_gesture_peek(sensor, &s_cursor, &data)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      // The dataset which ends the gesture is taken with the hand gone
+      if (data[i].up == 0 && data[i].down == 0 && data[i].left == 0 && data[i].right == 0) {
+        continue;
+      }
+      if (data[i].up != 100 || data[i].down != 110 || data[i].left != 120 || data[i].right != 130) {
+        s_mismatches++;
+      }
+    }
+    s_datasets += n;
+    mgos_apds9960_gesture_consume(&s_cursor, n);
+  }
+}
+
+// The same hand, held for 500ms from the start of a test
+static void hold(int64_t time_us, struct mgos_apds9960_sim_input *input, void *arg) {
+  int64_t t = time_us - *(int64_t *)arg;
+
+  memset(input, 0, sizeof(*input));
+  if (t >= 100000 && t < 600000) {
+    input->proximity     = 200;
+    input->gesture.up    = 100;
+    input->gesture.down  = 110;
+    input->gesture.left  = 120;
+    input->gesture.right = 130;
+  }
+}
+
+static void test_drain(void) {
+  struct mgos_apds9960_gesture_drain_stats stats;
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960 *sensor;
+
+  mgos_host_gpio_attach(IRQ_PIN, sim);
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, IRQ_PIN);
+  CHECK(sensor != NULL);
+
+  mgos_apds9960_sim_set_waveform(sim, hand, NULL);
+  mgos_apds9960_gesture_cursor_init(sensor, &s_cursor);
+  CHECK(mgos_apds9960_set_callback_gesture_stream(sensor, stream));
+  mgos_host_run(500000);
+
+  // Every dataset is drained, in order and intact, without overflowing
+  CHECK(s_events > 0);
+  CHECK(s_datasets > 10);
+  CHECK_EQ(s_mismatches, 0);
+  CHECK_EQ(s_cursor.lost, 0);
+  CHECK(mgos_apds9960_get_gesture_drain_stats(sensor, &stats));
+  CHECK_EQ(stats.lost_total, 0);
+  CHECK_EQ(mgos_apds9960_get_gesture_fifo_overflows(sensor), 0);
+
+  // Gesture mode was left once the hand was gone, and the line released
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GCONF4) & 0b00000001, 0);
+  CHECK(mgos_gpio_read(IRQ_PIN));
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_host_gpio_detach(IRQ_PIN);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static void test_autotune(void) {
+  struct mgos_apds9960_gesture_drain_stats stats;
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960 *sensor;
+  int64_t start_us;
+  int     i;
+
+  mgos_host_gpio_attach(IRQ_PIN + 1, sim);
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, IRQ_PIN + 1);
+  CHECK(sensor != NULL);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GCONF1) >> 6, APDS9960_GFIFOTH_4);
+  CHECK(mgos_apds9960_set_gesture_fifo_autotune(sensor, true));
+  mgos_apds9960_gesture_cursor_init(sensor, &s_cursor);
+  CHECK(mgos_apds9960_set_callback_gesture_stream(sensor, stream));
+
+  // Drained as soon as it interrupts, the FIFO never backs up, so the
+  // threshold goes up to the largest one
+  start_us = mgos_apds9960_sim_time_us();
+  mgos_apds9960_sim_set_waveform(sim, hold, &start_us);
+  mgos_host_run(800000);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GCONF1) >> 6, APDS9960_GFIFOTH_16);
+  CHECK(mgos_apds9960_get_gesture_drain_stats(sensor, &stats));
+  CHECK_EQ(stats.lost_total, 0);
+
+  // Next time the worker is held off after the first interrupt for long
+  // enough for the FIFO to overflow
+  start_us = mgos_apds9960_sim_time_us();
+  for (i = 0; i < 400 && !mgos_apds9960_sim_int_asserted(sim); i++) {
+    mgos_apds9960_sim_advance(MGOS_HOST_TICK_US);
+    mgos_host_run_gpio();
+  }
+  CHECK(mgos_apds9960_sim_int_asserted(sim));
+  mgos_apds9960_sim_advance(200000);
+  CHECK(mgos_apds9960_sim_get_reg(sim, APDS9960_GSTATUS) & APDS9960_GFOV);
+  mgos_host_run_callbacks();
+
+  // The overflow is reported and the threshold drops to a single dataset.
+  // The autotune leaves the gesture wait time (GCONF2 GWTIME) alone.
+  CHECK(mgos_apds9960_get_gesture_drain_stats(sensor, &stats));
+  CHECK(stats.lost > 0);
+  CHECK_EQ(stats.lost_total, stats.lost);
+  CHECK_EQ(mgos_apds9960_get_gesture_fifo_overflows(sensor), 1);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GCONF1) >> 6, APDS9960_GFIFOTH_1);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GCONF2) & 0b00000111, APDS9960_DEFAULT_GWTIME);
+  mgos_host_run(800000);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_host_gpio_detach(IRQ_PIN + 1);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+int main(void) {
+  test_drain();
+  test_autotune();
+  return 0;
+}
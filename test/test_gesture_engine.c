@@ -0,0 +1,132 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS            ((struct mgos_i2c *)0x1)
+#define IRQ_PIN        7
+#define SWIPE_US       200000
+
+struct swipe {
+  int64_t start_us;
+  uint8_t up, down, left, right;  // Which way each channel ramps: 0 flat, 1 rising, 2 falling
+};
+
+static enum mgos_apds9960_direction_t s_direction;
+static int s_events = 0;
+
+static void gesture(enum mgos_apds9960_direction_t direction) {
+  s_direction = direction;
+  s_events++;
+}
+
+static uint8_t ramp(uint8_t kind, int64_t t_us) {
+  uint32_t pos = (uint32_t)(t_us * 120 / SWIPE_US);
+
+  switch (kind) {
+  case 1:
+    return 40 + pos;
+  case 2:
+    return 160 - pos;
+  case 3:
+    return 50 + pos * 150 / 120;
+  case 4:
+    return 200 - pos * 150 / 120;
+  default:
+    return 100;
+  }
+}
+
+// The hand is over the sensor for SWIPE_US, each channel following its ramp
+static void waveform(int64_t time_us, struct mgos_apds9960_sim_input *input, void *arg) {
+  const struct swipe *s = (const struct swipe *)arg;
+  int64_t t_us          = time_us - s->start_us;
+
+  memset(input, 0, sizeof(*input));
+  if (t_us >= 0 && t_us < SWIPE_US) {
+    input->proximity     = 200;
+    input->gesture.up    = ramp(s->up, t_us);
+    input->gesture.down  = ramp(s->down, t_us);
+    input->gesture.left  = ramp(s->left, t_us);
+    input->gesture.right = ramp(s->right, t_us);
+  }
+}
+
+static void run_swipe(struct mgos_apds9960_sim *sim, struct mgos_apds9960 *sensor, uint8_t up, uint8_t down, uint8_t left, uint8_t right,
+                      enum mgos_apds9960_direction_t expect, struct mgos_apds9960_gesture *result) {
+  struct swipe s = { mgos_apds9960_sim_time_us() + 50000, up, down, left, right };
+
+  s_events    = 0;
+  s_direction = APDS9960_DIR_NONE;
+  mgos_apds9960_sim_set_waveform(sim, waveform, &s);
+  mgos_host_run(500000);
+  mgos_apds9960_sim_set_waveform(sim, NULL, NULL);
+
+  CHECK_EQ(s_events, 1);
+  CHECK_EQ(s_direction, expect);
+  CHECK(mgos_apds9960_get_last_gesture(sensor, result));
+  CHECK_EQ(result->direction, expect);
+  CHECK(result->duration_ms > SWIPE_US / 1000 * 3 / 4 && result->duration_ms <= SWIPE_US / 1000);
+}
+
+int main(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960_gesture result;
+  struct mgos_apds9960 *sensor;
+
+  mgos_host_gpio_attach(IRQ_PIN, sim);
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, IRQ_PIN);
+  CHECK(sensor != NULL);
+  CHECK(mgos_apds9960_set_gesture_engine(sensor, NULL, NULL));
+  CHECK(mgos_apds9960_set_callback_gesture(sensor, gesture));
+
+  // U-D going from negative to positive is DOWN, L-R likewise is RIGHT. A
+  // clean swipe swings its axis by about 120 percent against a sensitivity
+  // of 50, which saturates the confidence. Speed is the swing per second.
+  run_swipe(sim, sensor, 1, 2, 0, 0, APDS9960_DIR_DOWN, &result);
+  CHECK_EQ(result.confidence, 100);
+  CHECK(result.speed >= 100 * 1000 / result.duration_ms && result.speed <= 120 * 1000 / result.duration_ms);
+  run_swipe(sim, sensor, 2, 1, 0, 0, APDS9960_DIR_UP, &result);
+  CHECK_EQ(result.confidence, 100);
+  CHECK(result.speed >= 100 * 1000 / result.duration_ms && result.speed <= 120 * 1000 / result.duration_ms);
+  run_swipe(sim, sensor, 0, 0, 1, 2, APDS9960_DIR_RIGHT, &result);
+  CHECK_EQ(result.confidence, 100);
+  run_swipe(sim, sensor, 0, 0, 2, 1, APDS9960_DIR_LEFT, &result);
+  CHECK_EQ(result.confidence, 100);
+
+  // Equal swings on both axes
+  run_swipe(sim, sensor, 1, 2, 1, 2, APDS9960_DIR_ALL, &result);
+  CHECK_EQ(result.confidence, 100);
+
+  // No ratio swing, but a total signal change of about 75 percent of the peak
+  run_swipe(sim, sensor, 3, 3, 3, 3, APDS9960_DIR_NEAR, &result);
+  CHECK_EQ(result.confidence, 100);
+  CHECK(result.speed >= 60 * 1000 / result.duration_ms && result.speed <= 75 * 1000 / result.duration_ms);
+  run_swipe(sim, sensor, 4, 4, 4, 4, APDS9960_DIR_FAR, &result);
+  CHECK_EQ(result.confidence, 100);
+
+  // A weak swing is reported with the confidence scaled down, up to 50 at
+  // exactly the sensitivity
+  CHECK(mgos_apds9960_set_gesture_sensitivity(sensor, APDS9960_GESTURE_THRESHOLD_OUT, 100));
+  run_swipe(sim, sensor, 1, 2, 0, 0, APDS9960_DIR_DOWN, &result);
+  CHECK(result.confidence >= 50 && result.confidence <= 60);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_host_gpio_detach(IRQ_PIN);
+  mgos_apds9960_sim_destroy(&sim);
+  return 0;
+}
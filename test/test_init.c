@@ -0,0 +1,179 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS    ((struct mgos_i2c *)0x1)
+
+static void test_create(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960_i2c_stats stats;
+  struct mgos_apds9960 *sensor;
+
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  CHECK(sensor != NULL);
+
+  // CONFIG1 through ID, gesture FIFO flush (GFLVL/GSTATUS, GCONF1), three
+  // bursts of defaults and the power on. No reset write, as the device is
+  // fresh out of power-on-reset.
+  CHECK(mgos_apds9960_get_i2c_stats(sensor, &stats));
+  CHECK_EQ(stats.transactions, 7);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_CONFIG1), APDS9960_DEFAULT_CONFIG1);
+  CHECK_EQ(stats.errors, 0);
+
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_ENABLE), APDS9960_PON);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_ATIME), APDS9960_DEFAULT_ATIME);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PERS), APDS9960_DEFAULT_PERS);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PPULSE), APDS9960_DEFAULT_PROX_PPULSE);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_CONFIG2), APDS9960_DEFAULT_CONFIG2);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GPULSE), APDS9960_DEFAULT_GPULSE);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GCONF3), APDS9960_DEFAULT_GCONF3);
+
+  // Destroying the driver instance powers the device down
+  mgos_apds9960_destroy(&sensor);
+  CHECK(sensor == NULL);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_ENABLE), 0x00);
+
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static void test_create_failures(void) {
+  struct mgos_apds9960_sim *sim;
+
+  CHECK(mgos_apds9960_create_irq(BUS, 0x39, -1) == NULL);
+
+  sim = mgos_apds9960_sim_create(BUS, 0x39);
+  mgos_apds9960_sim_set_nack(sim, true);
+  CHECK(mgos_apds9960_create_irq(BUS, 0x39, -1) == NULL);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static void test_shadow(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960_i2c_stats stats;
+  struct mgos_apds9960 *sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  uint8_t val;
+
+  // Configuration reads are served from the shadow copy
+  mgos_apds9960_reset_i2c_stats(sensor);
+  CHECK(mgos_apds9960_get_proximity_gain(sensor, &val));
+  CHECK_EQ(val, APDS9960_DEFAULT_PGAIN);
+  CHECK(mgos_apds9960_get_light_gain(sensor, &val));
+  CHECK_EQ(val, APDS9960_DEFAULT_AGAIN);
+  mgos_apds9960_get_i2c_stats(sensor, &stats);
+  CHECK_EQ(stats.transactions, 0);
+
+  // A read-modify-write is a single write
+  CHECK(mgos_apds9960_set_proximity_gain(sensor, 3));
+  mgos_apds9960_get_i2c_stats(sensor, &stats);
+  CHECK_EQ(stats.transactions, 1);
+  CHECK_EQ((mgos_apds9960_sim_get_reg(sim, APDS9960_CONTROL) >> 2) & 0b11, 3);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+// A device which was initialized before, and has not lost power since, gets
+// the reset write. One which has, is initialized again by resync(); one which
+// was merely powered down by the application is not.
+static void test_por(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960_i2c_stats stats;
+  struct mgos_apds9960 *sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  uint8_t val;
+
+  mgos_apds9960_destroy(&sensor);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_CONFIG1), APDS9960_DEFAULT_CONFIG1);
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  CHECK(sensor != NULL);
+  CHECK(mgos_apds9960_get_i2c_stats(sensor, &stats));
+  CHECK_EQ(stats.transactions, 8);
+
+  CHECK(mgos_apds9960_set_proximity_gain(sensor, 3));
+  CHECK(mgos_apds9960_disable(sensor));
+  mgos_apds9960_reset_i2c_stats(sensor);
+  CHECK(mgos_apds9960_resync(sensor));
+  CHECK(mgos_apds9960_get_i2c_stats(sensor, &stats));
+  CHECK_EQ(stats.transactions, 2);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_ENABLE), 0x00);
+  CHECK(mgos_apds9960_get_proximity_gain(sensor, &val));
+  CHECK_EQ(val, 3);
+
+  // Power cycled: a fresh device in the same place
+  mgos_apds9960_sim_destroy(&sim);
+  sim = mgos_apds9960_sim_create(BUS, 0x39);
+  CHECK(mgos_apds9960_resync(sensor));
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_ENABLE), APDS9960_PON);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_CONFIG1), APDS9960_DEFAULT_CONFIG1);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_ATIME), APDS9960_DEFAULT_ATIME);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GPENTH), APDS9960_DEFAULT_GPENTH);
+  CHECK(mgos_apds9960_get_proximity_gain(sensor, &val));
+  CHECK_EQ(val, APDS9960_DEFAULT_PGAIN);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static bool test_bus_select(struct mgos_apds9960 *sensor, void *arg) {
+  (void)sensor;
+  (void)arg;
+  return true;
+}
+
+static void test_calibration_restore(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960_calibration cal = { 0x11, 0x22, 0x03, 0x04, 0x05, 0x06 };
+  struct mgos_apds9960 *sensor;
+
+  CHECK(mgos_apds9960_save_calibration(&cal));
+
+  // Every creation path restores the stored set for the configured address
+  sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  CHECK(sensor != NULL);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_POFFSET_UR), 0x11);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_POFFSET_DL), 0x22);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_GOFFSET_R), 0x06);
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+
+  // Not to a sensor at another address
+  sim    = mgos_apds9960_sim_create(BUS, 0x3A);
+  sensor = mgos_apds9960_create_irq(BUS, 0x3A, -1);
+  CHECK(sensor != NULL);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_POFFSET_UR), 0x00);
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+
+  // Nor to one of several sensors behind a multiplexer
+  sim    = mgos_apds9960_sim_create(BUS, 0x39);
+  sensor = mgos_apds9960_create_mux(BUS, 0x39, -1, test_bus_select, NULL);
+  CHECK(sensor != NULL);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_POFFSET_UR), 0x00);
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+
+  mgos_sys_config.apds9960.calib.enable = false;
+}
+
+int main(void) {
+  test_create();
+  test_create_failures();
+  test_shadow();
+  test_por();
+  test_calibration_restore();
+  return 0;
+}
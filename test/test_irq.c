@@ -0,0 +1,261 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS1       ((struct mgos_i2c *)0x1)
+#define BUS2       ((struct mgos_i2c *)0x2)
+#define IRQ_PIN    5
+
+static int s_proximity_events = 0;
+
+static void proximity(uint8_t proximity) {
+  s_proximity_events++;
+  (void)proximity;
+}
+
+static void near(struct mgos_apds9960_sim *sim) {
+  struct mgos_apds9960_sim_input input = { 0 };
+
+  input.proximity = 200;
+  mgos_apds9960_sim_set_input(sim, &input);
+}
+
+// A sensor destroyed with its interrupt worker still queued
+static void test_destroy_pending_sensor(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960 *sensor;
+
+  mgos_host_gpio_attach(IRQ_PIN, sim);
+  sensor = mgos_apds9960_create_irq(BUS1, 0x39, IRQ_PIN);
+  CHECK(sensor != NULL);
+  mgos_apds9960_irq(IRQ_PIN, sensor);
+  mgos_apds9960_destroy(&sensor);
+  mgos_host_run_callbacks();
+  mgos_host_gpio_detach(IRQ_PIN);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+// Two sensors on one line are both serviced, and the line is released
+static void test_group(void) {
+  struct mgos_apds9960_sim *sim1 = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960_sim *sim2 = mgos_apds9960_sim_create(BUS2, 0x39);
+  struct mgos_apds9960 *s1 = mgos_apds9960_create_irq(BUS1, 0x39, -1);
+  struct mgos_apds9960 *s2 = mgos_apds9960_create_irq(BUS2, 0x39, -1);
+  struct mgos_apds9960_irq_group *group;
+
+  mgos_host_gpio_attach(IRQ_PIN + 1, sim1);
+  mgos_host_gpio_attach(IRQ_PIN + 1, sim2);
+  group = mgos_apds9960_irq_group_create(IRQ_PIN + 1);
+  CHECK(mgos_apds9960_irq_group_add(group, s1));
+  CHECK(mgos_apds9960_irq_group_add(group, s2));
+  CHECK(mgos_apds9960_set_callback_proximity(s1, 0, 100, proximity));
+  CHECK(mgos_apds9960_set_callback_proximity(s2, 0, 100, proximity));
+  near(sim1);
+  near(sim2);
+
+  mgos_host_run(200000);
+  CHECK(s_proximity_events >= 2);
+
+  // Destroyed with the worker queued, which then frees it
+  mgos_host_gpio_force_low(IRQ_PIN + 1, true);
+  mgos_host_run_gpio();
+  mgos_apds9960_irq_group_destroy(&group);
+  CHECK(group == NULL);
+  mgos_host_run_callbacks();
+
+  mgos_apds9960_destroy(&s1);
+  mgos_apds9960_destroy(&s2);
+  mgos_host_gpio_detach(IRQ_PIN + 1);
+  mgos_apds9960_sim_destroy(&sim1);
+  mgos_apds9960_sim_destroy(&sim2);
+}
+
+// A line held low by something the group cannot clear is retried on a
+// back-off timer a bounded number of times, not in a tight callback loop
+static void test_stuck_line(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960 *sensor  = mgos_apds9960_create_irq(BUS1, 0x39, -1);
+  struct mgos_apds9960_i2c_stats stats;
+  struct mgos_apds9960_irq_group *group;
+
+  mgos_host_gpio_attach(IRQ_PIN + 2, sim);
+  group = mgos_apds9960_irq_group_create(IRQ_PIN + 2);
+  CHECK(mgos_apds9960_irq_group_add(group, sensor));
+
+  mgos_apds9960_reset_i2c_stats(sensor);
+  mgos_host_reset_counters();
+  mgos_host_gpio_force_low(IRQ_PIN + 2, true);
+  mgos_host_run(1000000);
+  mgos_apds9960_get_i2c_stats(sensor, &stats);
+  CHECK_EQ(mgos_host_callbacks_run(), 1);
+  CHECK_EQ(stats.transactions, APDS9960_IRQ_GROUP_ROUNDS * APDS9960_IRQ_GROUP_PASSES);
+
+  // Destroyed while waiting for a back-off
+  mgos_host_gpio_force_low(IRQ_PIN + 2, false);
+  mgos_host_run(10000);
+  mgos_host_gpio_force_low(IRQ_PIN + 2, true);
+  mgos_host_run(1000);
+  mgos_apds9960_irq_group_destroy(&group);
+  mgos_host_run(100000);
+  mgos_host_gpio_detach(IRQ_PIN + 2);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static enum mgos_apds9960_direction_t s_presence[8];
+static int s_presence_events = 0;
+
+static void presence(enum mgos_apds9960_direction_t state, uint8_t proximity) {
+  if (s_presence_events < (int)(sizeof(s_presence) / sizeof(s_presence[0]))) {
+    s_presence[s_presence_events] = state;
+  }
+  s_presence_events++;
+  (void)proximity;
+}
+
+// A target approaches, lingers around the near threshold, leaves and lingers
+// around the far threshold, twice per second. The lingering crosses only one
+// threshold at a time, so the hysteresis must hold the state.
+static void approach(int64_t time_us, struct mgos_apds9960_sim_input *input, void *arg) {
+  int64_t t_us   = time_us - *(const int64_t *)arg;
+  int64_t t_ms   = (t_us / 1000) % 1000;
+  int     wobble = (t_us / 10000) % 2 ? 20 : -20;
+
+  memset(input, 0, sizeof(*input));
+  if (t_ms < 200) {
+    input->proximity = t_ms;                  // Ramp up to 200
+  } else if (t_ms < 500) {
+    input->proximity = 150 + wobble;          // Around near, never below far
+  } else if (t_ms < 700) {
+    input->proximity = 200 - (t_ms - 500);    // Ramp down to 0
+  } else {
+    input->proximity = 50 + wobble;           // Around far, never above near
+  }
+}
+
+static void test_presence(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960 *sensor;
+  int64_t start_us;
+
+  mgos_host_gpio_attach(IRQ_PIN + 3, sim);
+  sensor = mgos_apds9960_create_irq(BUS1, 0x39, IRQ_PIN + 3);
+  CHECK(sensor != NULL);
+  CHECK(!mgos_apds9960_set_callback_presence(sensor, 150, 50, 2, presence));
+  CHECK(mgos_apds9960_set_callback_presence(sensor, 50, 150, 2, presence));
+  CHECK_EQ(mgos_apds9960_get_presence(sensor), APDS9960_DIR_FAR);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PILT), 0);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PIHT), 150);
+
+  start_us = mgos_apds9960_sim_time_us();
+  mgos_apds9960_sim_set_waveform(sim, approach, &start_us);
+  mgos_host_run(350000);
+  CHECK_EQ(s_presence_events, 1);
+  CHECK_EQ(mgos_apds9960_get_presence(sensor), APDS9960_DIR_NEAR);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PILT), 50);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PIHT), 255);
+
+  mgos_host_run(650000);
+  CHECK_EQ(s_presence_events, 2);
+  CHECK_EQ(mgos_apds9960_get_presence(sensor), APDS9960_DIR_FAR);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PILT), 0);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_PIHT), 150);
+
+  mgos_host_run(1000000);
+  CHECK_EQ(s_presence_events, 4);
+  CHECK_EQ(s_presence[0], APDS9960_DIR_NEAR);
+  CHECK_EQ(s_presence[1], APDS9960_DIR_FAR);
+  CHECK_EQ(s_presence[2], APDS9960_DIR_NEAR);
+  CHECK_EQ(s_presence[3], APDS9960_DIR_FAR);
+  CHECK(mgos_gpio_read(IRQ_PIN + 3));
+
+  mgos_apds9960_sim_set_waveform(sim, NULL, NULL);
+  mgos_apds9960_destroy(&sensor);
+  mgos_host_gpio_detach(IRQ_PIN + 3);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static uint16_t clear_data(struct mgos_apds9960_sim *sim) {
+  return mgos_apds9960_sim_get_reg(sim, APDS9960_CDATAL) | (mgos_apds9960_sim_get_reg(sim, APDS9960_CDATAH) << 8);
+}
+
+// With sleep-after-interrupt, the device stops converting once its interrupt
+// is asserted, and resumes after clear_int(): a single address-only write to
+// AICLEAR
+static void test_sleep_after_int(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960_sim_input input = { 0 };
+  struct mgos_apds9960_sim_stats stats;
+  struct mgos_apds9960 *sensor;
+  bool enabled;
+
+  sensor = mgos_apds9960_create_irq(BUS1, 0x39, -1);
+  CHECK(sensor != NULL);
+  CHECK(mgos_apds9960_enable_light_sensor(sensor));
+  CHECK(mgos_apds9960_set_light_int_thresholds(sensor, 0xFFFF, 0));
+  CHECK(mgos_apds9960_set_light_int_enable(sensor, true));
+  CHECK(mgos_apds9960_set_sleep_after_int(sensor, true));
+  CHECK(mgos_apds9960_get_sleep_after_int(sensor, &enabled));
+  CHECK(enabled);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_CONFIG3) & 0x10, 0x10);
+
+  input.clear = 10;
+  mgos_apds9960_sim_set_input(sim, &input);
+  mgos_apds9960_sim_advance(150000);
+  CHECK(mgos_apds9960_sim_int_asserted(sim));
+  CHECK_EQ(clear_data(sim), 10 * 4 * 37);
+
+  // Asleep: the data no longer follows the input
+  input.clear = 20;
+  mgos_apds9960_sim_set_input(sim, &input);
+  mgos_apds9960_sim_advance(500000);
+  CHECK_EQ(clear_data(sim), 10 * 4 * 37);
+
+  mgos_apds9960_sim_reset_stats(sim);
+  CHECK(mgos_apds9960_clear_int(sensor));
+  mgos_apds9960_sim_get_stats(sim, &stats);
+  CHECK_EQ(stats.transactions, 1);
+  CHECK_EQ(stats.bytes_written, 1);
+  CHECK_EQ(stats.bytes_read, 0);
+  CHECK(!mgos_apds9960_sim_int_asserted(sim));
+
+  // Awake for one more conversion, which interrupts again
+  mgos_apds9960_sim_advance(150000);
+  CHECK_EQ(clear_data(sim), 20 * 4 * 37);
+  CHECK(mgos_apds9960_sim_int_asserted(sim));
+
+  // Without SAI, conversions carry on with the interrupt pending
+  CHECK(mgos_apds9960_set_sleep_after_int(sensor, false));
+  input.clear = 30;
+  mgos_apds9960_sim_set_input(sim, &input);
+  mgos_apds9960_sim_advance(150000);
+  CHECK_EQ(clear_data(sim), 30 * 4 * 37);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+int main(void) {
+  test_destroy_pending_sensor();
+  test_group();
+  test_stuck_line();
+  test_presence();
+  test_sleep_after_int();
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS    ((struct mgos_i2c *)0x1)
+
+static void test_profile_config1(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960 *sensor  = mgos_apds9960_create_irq(BUS, 0x39, -1);
+
+  CHECK(sensor != NULL);
+
+  // Only WLONG is owned by the profiles, other CONFIG1 bits are kept
+  CHECK(mgos_apds9960_wireWriteDataByte(sensor, APDS9960_CONFIG1, APDS9960_DEFAULT_CONFIG1 | 0x01));
+  CHECK(mgos_apds9960_set_power_profile(sensor, APDS9960_POWER_PRESENCE, NULL));
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_CONFIG1), APDS9960_DEFAULT_CONFIG1 | 0x01 | APDS9960_WLONG);
+  CHECK(mgos_apds9960_set_power_profile(sensor, APDS9960_POWER_BALANCED, NULL));
+  CHECK_EQ(mgos_apds9960_sim_get_reg(sim, APDS9960_CONFIG1), APDS9960_DEFAULT_CONFIG1 | 0x01);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static void test_estimate(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS, 0x39);
+  struct mgos_apds9960 *sensor  = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  struct mgos_apds9960_power_estimate est;
+  uint32_t cycle_us;
+
+  CHECK(sensor != NULL);
+
+  // The estimate follows the cycle time the sampler works with
+  for (int profile = APDS9960_POWER_PRESENCE; profile <= APDS9960_POWER_GESTURE; profile++) {
+    CHECK(mgos_apds9960_set_power_profile(sensor, profile, &est));
+    CHECK(mgos_apds9960_get_cycle_time(sensor, &cycle_us));
+    CHECK_EQ(est.cycle_us, cycle_us);
+    CHECK_EQ(est.sample_rate_millihz, 1000000000 / cycle_us);
+    CHECK(est.current_ua > 0);
+  }
+
+  // Presence: 4 pulses of 8us and (256 - 248) x 12 x 2.78ms of wait
+  CHECK(mgos_apds9960_set_power_profile(sensor, APDS9960_POWER_PRESENCE, &est));
+  CHECK_EQ(est.cycle_us, mgos_apds9960_pulse_time_us(0x43) + 8 * 12 * 2780);
+  CHECK_EQ(est.gesture_rate_hz, 0);
+
+  // Powered down, only the sleep current remains
+  CHECK(mgos_apds9960_wireWriteDataByte(sensor, APDS9960_ENABLE, 0x00));
+  CHECK(mgos_apds9960_get_power_estimate(sensor, &est));
+  CHECK_EQ(est.current_ua, 1);
+  CHECK_EQ(est.sample_rate_millihz, 0);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+int main(void) {
+  test_profile_config1();
+  test_estimate();
+  return 0;
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS1    ((struct mgos_i2c *)0x1)
+#define BUS2    ((struct mgos_i2c *)0x2)
+
+struct sample_log {
+  int      num[2];
+  int      stale;
+  uint16_t clear;
+};
+
+static struct mgos_apds9960 *s_sensors[2];
+
+static void sampled(const struct mgos_apds9960_sample *sample, void *arg) {
+  struct sample_log *log = (struct sample_log *)arg;
+
+  log->num[sample->sensor == s_sensors[1]]++;
+  if (!(sample->status & APDS9960_STATUS_AVALID)) {
+    log->stale++;
+  }
+  log->clear = sample->rgbc.clear;
+}
+
+// The period is rounded up to whole cycles of the slowest sensor, and every
+// sensor then delivers one fresh sample per interval
+static void test_interval(void) {
+  struct mgos_apds9960_sim *sim1 = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960_sim *sim2 = mgos_apds9960_sim_create(BUS2, 0x39);
+  struct mgos_apds9960_sim_input input = { 0 };
+  struct mgos_apds9960_sampler *sampler;
+  struct sample_log log = { 0 };
+  uint32_t cycle_us, interval_ms;
+
+  s_sensors[0] = mgos_apds9960_create_irq(BUS1, 0x39, -1);
+  s_sensors[1] = mgos_apds9960_create_irq(BUS2, 0x39, -1);
+  CHECK(s_sensors[0] != NULL && s_sensors[1] != NULL);
+  CHECK(mgos_apds9960_enable_light_sensor(s_sensors[0]));
+  CHECK(mgos_apds9960_enable_light_sensor(s_sensors[1]));
+  CHECK(mgos_apds9960_set_light_integration_time(s_sensors[1], 256 - 72));
+  input.clear = 10;
+  mgos_apds9960_sim_set_input(sim1, &input);
+  mgos_apds9960_sim_set_input(sim2, &input);
+
+  sampler = mgos_apds9960_sampler_create(250, sampled, &log);
+  CHECK(sampler != NULL);
+  CHECK(mgos_apds9960_sampler_add(sampler, s_sensors[0]));
+  CHECK(mgos_apds9960_get_cycle_time(s_sensors[0], &cycle_us));
+  CHECK_EQ(cycle_us, 37 * 2780);
+  interval_ms = (((250000 + cycle_us - 1) / cycle_us) * cycle_us + 999) / 1000;
+  CHECK_EQ(mgos_apds9960_sampler_get_interval(sampler), interval_ms);
+  CHECK_EQ(interval_ms, 309);
+
+  // The second sensor integrates for 200ms: two of its cycles
+  CHECK(mgos_apds9960_sampler_add(sampler, s_sensors[1]));
+  CHECK(mgos_apds9960_get_cycle_time(s_sensors[1], &cycle_us));
+  CHECK_EQ(mgos_apds9960_sampler_get_interval(sampler), (2 * cycle_us + 999) / 1000);
+  interval_ms = mgos_apds9960_sampler_get_interval(sampler);
+
+  mgos_host_run(10 * interval_ms * 1000 + 500);
+  CHECK_EQ(log.num[0], 10);
+  CHECK_EQ(log.num[1], 10);
+  CHECK_EQ(log.stale, 0);
+  CHECK_EQ(log.clear, 10 * 4 * 72);
+
+  // Removing the slow sensor brings the interval back down
+  CHECK(mgos_apds9960_sampler_remove(sampler, s_sensors[1]));
+  CHECK_EQ(mgos_apds9960_sampler_get_interval(sampler), 309);
+
+  mgos_apds9960_sampler_destroy(&sampler);
+  CHECK(sampler == NULL);
+  mgos_apds9960_destroy(&s_sensors[0]);
+  mgos_apds9960_destroy(&s_sensors[1]);
+  mgos_apds9960_sim_destroy(&sim1);
+  mgos_apds9960_sim_destroy(&sim2);
+}
+
+// Periods beyond 32 bits of usec are rounded without wrapping
+static void test_long_period(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960_sampler *sampler;
+  struct sample_log log = { 0 };
+  uint32_t period_ms = 5 * 3600 * 1000, cycle_us;
+
+  s_sensors[0] = mgos_apds9960_create_irq(BUS1, 0x39, -1);
+  CHECK(mgos_apds9960_enable_light_sensor(s_sensors[0]));
+  CHECK(mgos_apds9960_get_cycle_time(s_sensors[0], &cycle_us));
+
+  sampler = mgos_apds9960_sampler_create(period_ms, sampled, &log);
+  CHECK(mgos_apds9960_sampler_add(sampler, s_sensors[0]));
+  CHECK(mgos_apds9960_sampler_get_interval(sampler) >= period_ms);
+  CHECK(mgos_apds9960_sampler_get_interval(sampler) <= period_ms + cycle_us / 1000 + 1);
+
+  mgos_apds9960_sampler_destroy(&sampler);
+  mgos_apds9960_destroy(&s_sensors[0]);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+struct async_log {
+  int                         num;
+  int                         timeouts;
+  struct mgos_apds9960_sample sample;
+};
+
+static void async_sampled(const struct mgos_apds9960_sample *sample, void *arg) {
+  struct async_log *log = (struct async_log *)arg;
+
+  log->num++;
+  if (!sample) {
+    log->timeouts++;
+    return;
+  }
+  log->sample = *sample;
+}
+
+// Light and proximity conversions complete, then the device is put to sleep
+// by a light interrupt it cannot leave on its own
+static void sleep_after_light_int(struct mgos_apds9960 *sensor) {
+  CHECK(mgos_apds9960_set_light_int_thresholds(sensor, 0xFFFF, 0));
+  CHECK(mgos_apds9960_set_light_int_enable(sensor, true));
+  CHECK(mgos_apds9960_set_sleep_after_int(sensor, true));
+  mgos_apds9960_sim_advance(300000);
+}
+
+static void test_wait_for_sample(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960_sim_input input = { 0 };
+  struct mgos_apds9960_sample sample;
+  struct mgos_apds9960 *sensor;
+  uint32_t cycle_us;
+  int64_t  start_us;
+
+  sensor = mgos_apds9960_create_irq(BUS1, 0x39, -1);
+  CHECK(mgos_apds9960_enable_light_sensor(sensor));
+  input.clear     = 10;
+  input.proximity = 50;
+  mgos_apds9960_sim_set_input(sim, &input);
+
+  // Proximity is not enabled
+  start_us = mgos_uptime_micros();
+  CHECK(!mgos_apds9960_wait_for_sample(sensor, APDS9960_STATUS_PVALID, &sample));
+  CHECK_EQ(mgos_uptime_micros(), start_us);
+
+  // Each wait returns the data of a conversion completed in the meantime,
+  // and a second wait does not return the same one again
+  CHECK(mgos_apds9960_enable_proximity_sensor(sensor));
+  CHECK(mgos_apds9960_get_cycle_time(sensor, &cycle_us));
+  for (int i = 0; i < 2; i++) {
+    start_us = mgos_uptime_micros();
+    CHECK(mgos_apds9960_wait_for_sample(sensor, APDS9960_STATUS_AVALID | APDS9960_STATUS_PVALID, &sample));
+    CHECK(sample.sensor == sensor);
+    CHECK_EQ(sample.status & (APDS9960_STATUS_AVALID | APDS9960_STATUS_PVALID), APDS9960_STATUS_AVALID | APDS9960_STATUS_PVALID);
+    CHECK_EQ(sample.rgbc.clear, 10 * 4 * 37);
+    CHECK_EQ(sample.proximity, mgos_apds9960_sim_get_reg(sim, APDS9960_PDATA));
+    CHECK(sample.proximity > 0);
+    CHECK(mgos_uptime_micros() - start_us <= cycle_us + cycle_us / 4 + APDS9960_SAMPLE_MARGIN_US);
+  }
+  CHECK(mgos_uptime_micros() - start_us >= cycle_us / 2);
+
+  // Nothing more completes while the device sleeps: the wait gives up after
+  // a cycle and a quarter plus the margin
+  sleep_after_light_int(sensor);
+  mgos_apds9960_wait_for_sample(sensor, APDS9960_STATUS_AVALID, &sample);
+  start_us = mgos_uptime_micros();
+  CHECK(!mgos_apds9960_wait_for_sample(sensor, APDS9960_STATUS_AVALID, &sample));
+  CHECK(mgos_uptime_micros() - start_us >= cycle_us + cycle_us / 4 + APDS9960_SAMPLE_MARGIN_US);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+static void test_read_sample_async(void) {
+  struct mgos_apds9960_sim *sim = mgos_apds9960_sim_create(BUS1, 0x39);
+  struct mgos_apds9960_sim_input input = { 0 };
+  struct async_log log = { 0 };
+  struct mgos_apds9960 *sensor;
+
+  sensor = mgos_apds9960_create_irq(BUS1, 0x39, -1);
+  CHECK(mgos_apds9960_enable_light_sensor(sensor));
+  input.clear = 10;
+  input.red   = 3;
+  input.blue  = 1;
+  mgos_apds9960_sim_set_input(sim, &input);
+
+  // The handler gets the burst read with AVALID set, once
+  CHECK(mgos_apds9960_read_sample_async(sensor, APDS9960_STATUS_AVALID, async_sampled, &log));
+  CHECK(!mgos_apds9960_read_sample_async(sensor, APDS9960_STATUS_AVALID, async_sampled, &log));
+  mgos_host_run(500000);
+  CHECK_EQ(log.num, 1);
+  CHECK_EQ(log.timeouts, 0);
+  CHECK(log.sample.status & APDS9960_STATUS_AVALID);
+  CHECK_EQ(log.sample.rgbc.clear, 10 * 4 * 37);
+  CHECK_EQ(log.sample.rgbc.red, 3 * 4 * 37);
+  CHECK_EQ(log.sample.rgbc.green, 0);
+  CHECK_EQ(log.sample.rgbc.blue, 1 * 4 * 37);
+
+  // And NULL once the deadline passed without a conversion
+  sleep_after_light_int(sensor);
+  mgos_apds9960_wait_for_sample(sensor, APDS9960_STATUS_AVALID, &log.sample);
+  CHECK(mgos_apds9960_read_sample_async(sensor, APDS9960_STATUS_AVALID, async_sampled, &log));
+  mgos_host_run(500000);
+  CHECK_EQ(log.num, 2);
+  CHECK_EQ(log.timeouts, 1);
+
+  mgos_apds9960_destroy(&sensor);
+  mgos_apds9960_sim_destroy(&sim);
+}
+
+int main(void) {
+  test_interval();
+  test_long_period();
+  test_wait_for_sample();
+  test_read_sample_async();
+  return 0;
+}
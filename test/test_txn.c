@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mgos_host.h"
+#include "mgos_apds9960_internal.h"
+
+#define BUS    ((struct mgos_i2c *)0x1)
+
+static struct mgos_apds9960_sim *s_sim;
+static struct mgos_apds9960 *    s_sensor;
+
+static uint32_t transactions(void) {
+  struct mgos_apds9960_i2c_stats stats;
+
+  mgos_apds9960_get_i2c_stats(s_sensor, &stats);
+  mgos_apds9960_reset_i2c_stats(s_sensor);
+  return stats.transactions;
+}
+
+// PILT and PIHT merge into one burst over the reserved register in between
+static void test_bridge_reserved(void) {
+  transactions();
+  CHECK(mgos_apds9960_set_proximity_int_thresholds(s_sensor, 10, 200));
+  CHECK_EQ(transactions(), 1);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, APDS9960_PILT), 10);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, 0x8A), 0x00);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, APDS9960_PIHT), 200);
+}
+
+// GOFFSET_U..R bridge over GPULSE only while its value is known
+static void test_bridge_shadowed(void) {
+  struct mgos_apds9960_calibration cal = { 1, 2, 3, 4, 5, 6 }, out;
+
+  mgos_apds9960_shadow_invalidate(s_sensor);
+  transactions();
+  CHECK(mgos_apds9960_set_calibration(s_sensor, &cal));
+  CHECK_EQ(transactions(), 3);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, APDS9960_GPULSE), APDS9960_DEFAULT_GPULSE);
+
+  CHECK(mgos_apds9960_resync(s_sensor));
+  transactions();
+  CHECK(mgos_apds9960_set_calibration(s_sensor, &cal));
+  CHECK_EQ(transactions(), 2);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, APDS9960_GPULSE), APDS9960_DEFAULT_GPULSE);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, APDS9960_GOFFSET_R), 6);
+
+  // Cold reads merge the same way, warm ones do not touch the bus
+  mgos_apds9960_shadow_invalidate(s_sensor);
+  transactions();
+  CHECK(mgos_apds9960_get_calibration(s_sensor, &out));
+  CHECK_EQ(transactions(), 2);
+  CHECK(memcmp(&cal, &out, sizeof(cal)) == 0);
+  CHECK(mgos_apds9960_get_calibration(s_sensor, &out));
+  CHECK_EQ(transactions(), 0);
+}
+
+// Writes go out before reads, and the last write to a register wins
+static void test_order(void) {
+  struct mgos_apds9960_txn txn;
+  uint8_t ppulse = 0, id = 0, status = 0;
+
+  transactions();
+  mgos_apds9960_txn_init(&txn, s_sensor);
+  mgos_apds9960_txn_read(&txn, APDS9960_STATUS, &status);
+  mgos_apds9960_txn_write(&txn, APDS9960_PPULSE, 0x01);
+  mgos_apds9960_txn_read(&txn, APDS9960_ID, &id);
+  mgos_apds9960_txn_write(&txn, APDS9960_PPULSE, 0x55);
+  mgos_apds9960_txn_read(&txn, APDS9960_PPULSE, &ppulse);
+  CHECK(mgos_apds9960_txn_commit(&txn));
+  CHECK_EQ(transactions(), 2);
+  CHECK_EQ(id, APDS9960_ID_1);
+  CHECK_EQ(ppulse, 0x55);
+  CHECK_EQ(mgos_apds9960_sim_get_reg(s_sim, APDS9960_PPULSE), 0x55);
+}
+
+static void test_overflow(void) {
+  struct mgos_apds9960_txn txn;
+
+  mgos_apds9960_txn_init(&txn, s_sensor);
+  for (int i = 0; i < APDS9960_TXN_SIZE; i++) {
+    CHECK(mgos_apds9960_txn_write(&txn, APDS9960_AILTL, 0));
+  }
+  CHECK(!mgos_apds9960_txn_write(&txn, APDS9960_AILTL, 0));
+  transactions();
+  CHECK(!mgos_apds9960_txn_commit(&txn));
+  CHECK_EQ(transactions(), 0);
+}
+
+static void test_failure(void) {
+  struct mgos_apds9960_txn txn;
+
+  mgos_apds9960_sim_set_nack(s_sim, true);
+  mgos_apds9960_txn_init(&txn, s_sensor);
+  mgos_apds9960_txn_write(&txn, APDS9960_PILT, 1);
+  CHECK(!mgos_apds9960_txn_commit(&txn));
+  mgos_apds9960_sim_set_nack(s_sim, false);
+}
+
+int main(void) {
+  s_sim    = mgos_apds9960_sim_create(BUS, 0x39);
+  s_sensor = mgos_apds9960_create_irq(BUS, 0x39, -1);
+  CHECK(s_sensor != NULL);
+
+  test_bridge_reserved();
+  test_bridge_shadowed();
+  test_order();
+  test_overflow();
+  test_failure();
+
+  mgos_apds9960_destroy(&s_sensor);
+  mgos_apds9960_sim_destroy(&s_sim);
+  return 0;
+}